@@ -0,0 +1,73 @@
+/**
+ * Insert and lookup cost for a key stream that defeats std::hash being the identity for
+ * integers: multiples of the largest bucket count, 2039, all pile into one bucket. Random
+ * keys are included for comparison.
+ *
+ * Usage: adversarial [keys] [lookups]
+ */
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+#include "hash_map.h"
+
+static void measure(const char *name, const std::vector<int64_t> &keys, size_t lookups)
+{
+    hash_map<int64_t, int64_t> map(209, 0.7, 0.2);
+    auto start = std::chrono::steady_clock::now();
+    for (int64_t key : keys)
+    {
+        map.insert(key, key);
+    }
+    double insert_ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / keys.size();
+
+    // half of the lookups are keys that land in the same buckets but aren't in the map
+    std::mt19937_64 rng(2);
+    std::vector<int64_t> probes(lookups);
+    for (int64_t &probe : probes)
+    {
+        int64_t key = keys[rng() % keys.size()];
+        probe = rng() % 2 == 0 ? key : key + int64_t(keys.size()) * 2039;
+    }
+    size_t hits = 0;
+    start = std::chrono::steady_clock::now();
+    for (int64_t probe : probes)
+    {
+        hits += map.contains(probe);
+    }
+    double lookup_ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / lookups;
+
+    size_t *sizes = new size_t[map.get_capacity()];
+    map.get_bucket_sizes(sizes);
+    size_t longest = 0;
+    for (size_t i = 0; i < map.get_capacity(); i++)
+    {
+        longest = std::max(longest, sizes[i]);
+    }
+    delete[] sizes;
+
+    std::cout << name << ": insert " << insert_ns << " ns, lookup " << lookup_ns << " ns (" << hits
+              << " hits), longest bucket " << longest << std::endl;
+}
+
+int main(int argc, char **argv)
+{
+    size_t count = argc > 1 ? std::stoul(argv[1]) : 20000;
+    size_t lookups = argc > 2 ? std::stoul(argv[2]) : 200000;
+
+    std::vector<int64_t> random(count);
+    std::vector<int64_t> multiples_2039(count);
+    std::mt19937_64 rng(1);
+    for (size_t i = 0; i < count; i++)
+    {
+        random[i] = int64_t(rng() >> 1);
+        multiples_2039[i] = int64_t(i) * 2039;
+    }
+
+    measure("random keys  ", random, lookups);
+    measure("2039 * i keys", multiples_2039, lookups);
+    return 0;
+}
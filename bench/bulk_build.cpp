@@ -0,0 +1,52 @@
+/**
+ * Time to build a hash_map from unsorted pairs with bulk_insert on 1, 2, 4, ... threads,
+ * against inserting them one at a time.
+ *
+ * Usage: bulk_build [pairs] [distinct keys] [seed]
+ */
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <stdint.h>
+
+#include "hash_map.h"
+
+int main(int argc, char **argv)
+{
+    size_t count = argc > 1 ? std::stoul(argv[1]) : 2000000;
+    size_t distinct = argc > 2 ? std::stoul(argv[2]) : 200000;
+    unsigned seed = argc > 3 ? std::stoul(argv[3]) : 1;
+
+    std::mt19937_64 rng(seed);
+    std::vector<std::pair<uint64_t, uint64_t>> pairs(count);
+    for (size_t i = 0; i < count; i++)
+    {
+        pairs[i] = {rng() % distinct, i};
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    hash_map<uint64_t, uint64_t> serial(209, 0.7, 0.2);
+    for (const std::pair<uint64_t, uint64_t> &pair : pairs)
+    {
+        serial.insert(pair.first, pair.second);
+    }
+    double serial_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::cout << count << " pairs, " << serial.get_size() << " keys" << std::endl;
+    std::cout << "insert loop:           " << serial_ms << " ms" << std::endl;
+
+    size_t cores = std::max(std::thread::hardware_concurrency(), 1u);
+    for (size_t threads = 1; threads <= cores; threads *= 2)
+    {
+        start = std::chrono::steady_clock::now();
+        hash_map<uint64_t, uint64_t> built(209, 0.7, 0.2);
+        built.bulk_insert(pairs.data(), pairs.size(), threads);
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "bulk_insert, " << threads << " threads: " << ms << " ms"
+                  << (built.get_size() == serial.get_size() ? "" : " (WRONG SIZE)") << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,109 @@
+/**
+ * Copies and moves of K and V per call for the ways of putting a key/value pair into a
+ * hash_map, using string-backed key and value types that count their copies and moves.
+ *
+ * Usage: copies [keys]
+ */
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "hash_map.h"
+
+/** A string that counts how often it is copied and moved */
+struct counted
+{
+    static size_t copies;
+    static size_t moves;
+
+    std::string text;
+
+    counted() = default;
+    counted(std::string text) : text(std::move(text)) {}
+    counted(const counted &other) : text(other.text) { copies++; }
+    counted(counted &&other) noexcept : text(std::move(other.text)) { moves++; }
+
+    counted &operator=(const counted &other)
+    {
+        text = other.text;
+        copies++;
+        return *this;
+    }
+
+    counted &operator=(counted &&other) noexcept
+    {
+        text = std::move(other.text);
+        moves++;
+        return *this;
+    }
+
+    bool operator==(const counted &other) const { return text == other.text; }
+};
+
+size_t counted::copies = 0;
+size_t counted::moves = 0;
+
+namespace std
+{
+template <>
+struct hash<counted>
+{
+    size_t operator()(const counted &key) const { return hash<string>()(key.text); }
+};
+}
+
+/** Runs put(map, i) for every key twice, once inserting and once updating, and reports */
+template <typename Put>
+static void measure(const char *name, size_t keys, Put put)
+{
+    hash_map<counted, counted> map(209, 0.7, 0.2);
+    for (int pass = 0; pass < 2; pass++)
+    {
+        counted::copies = 0;
+        counted::moves = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < keys; i++)
+        {
+            put(map, i);
+        }
+        double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        std::cout << name << (pass == 0 ? " (new keys):      " : " (existing keys): ")
+                  << double(counted::copies) / keys << " copies, " << double(counted::moves) / keys
+                  << " moves, " << ns / keys << " ns per call" << std::endl;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    size_t keys = argc > 1 ? std::stoul(argv[1]) : 2000;
+
+    // long enough that the strings live on the heap, so every copy allocates
+    auto key_text = [](size_t i) { return "key-" + std::to_string(i) + std::string(40, 'k'); };
+    auto value_text = [](size_t i) { return "value-" + std::to_string(i) + std::string(200, 'v'); };
+
+    measure("insert(k, v)              ", keys, [&](hash_map<counted, counted> &map, size_t i) {
+        counted key(key_text(i));
+        counted value(value_text(i));
+        map.insert(key, value);
+    });
+    measure("insert(move(k), move(v))  ", keys, [&](hash_map<counted, counted> &map, size_t i) {
+        counted key(key_text(i));
+        counted value(value_text(i));
+        map.insert(std::move(key), std::move(value));
+    });
+    measure("insert_or_assign(move, move)", keys, [&](hash_map<counted, counted> &map, size_t i) {
+        counted key(key_text(i));
+        counted value(value_text(i));
+        map.insert_or_assign(std::move(key), std::move(value));
+    });
+    measure("try_emplace(move(k), text)", keys, [&](hash_map<counted, counted> &map, size_t i) {
+        counted key(key_text(i));
+        map.try_emplace(std::move(key), value_text(i));
+    });
+    measure("emplace(text, text)       ", keys, [&](hash_map<counted, counted> &map, size_t i) {
+        map.emplace(key_text(i), value_text(i));
+    });
+    return 0;
+}
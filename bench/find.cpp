@@ -0,0 +1,88 @@
+/**
+ * Lookup cost of get_value, which copies the value out, against find and contains, which
+ * don't, for values of a few sizes.
+ *
+ * Usage: find [entries] [lookups]
+ */
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+#include "hash_map.h"
+
+/** A plain value of Bytes bytes */
+template <size_t Bytes>
+struct blob
+{
+    uint64_t words[Bytes / 8];
+};
+
+/** Makes the compiler assume *p is read, so a copy into it can't be optimized away */
+template <typename T>
+static void escape(T *p)
+{
+    asm volatile("" : : "g"(p) : "memory");
+}
+
+/** Returns the mean nanoseconds per call of look(key) over keys */
+template <typename Look>
+static double time_calls(const std::vector<uint64_t> &keys, Look look)
+{
+    auto start = std::chrono::steady_clock::now();
+    for (uint64_t key : keys)
+    {
+        look(key);
+    }
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / keys.size();
+}
+
+template <size_t Bytes>
+static void measure(size_t entries, const std::vector<uint64_t> &keys)
+{
+    hash_map<uint64_t, blob<Bytes>> map(209, 0.7, 0.2);
+    for (uint64_t key = 0; key < entries; key++)
+    {
+        blob<Bytes> value;
+        for (uint64_t &word : value.words)
+        {
+            word = key;
+        }
+        map.insert(key, value);
+    }
+
+    double copied = time_calls(keys, [&](uint64_t key) {
+        std::optional<blob<Bytes>> found = map.get_value(key);
+        escape(&found);
+    });
+    double in_place = time_calls(keys, [&](uint64_t key) {
+        const blob<Bytes> *found = map.find(key);
+        escape(&found);
+    });
+    double present = time_calls(keys, [&](uint64_t key) {
+        bool found = map.contains(key);
+        escape(&found);
+    });
+    std::cout << Bytes << " byte values: get_value " << copied << " ns, find " << in_place
+              << " ns, contains " << present << " ns" << std::endl;
+}
+
+int main(int argc, char **argv)
+{
+    size_t entries = argc > 1 ? std::stoul(argv[1]) : 100000;
+    size_t lookups = argc > 2 ? std::stoul(argv[2]) : 1000000;
+
+    std::mt19937_64 rng(1);
+    std::vector<uint64_t> keys(lookups);
+    for (uint64_t &key : keys)
+    {
+        key = rng() % (entries * 2);
+    }
+
+    measure<8>(entries, keys);
+    measure<256>(entries, keys);
+    measure<4096>(entries, keys);
+    return 0;
+}
@@ -0,0 +1,100 @@
+/**
+ * Memory per entry and lookup latency of a live hash_map against the frozen_hash_map that
+ * freeze() builds from it.
+ *
+ * Usage: freeze [entries] [lookups] [seed]
+ *
+ * Memory is what each map requests from its resource, so allocator headers aren't counted
+ * for either. Lookups are random keys, half of them present.
+ */
+#include <chrono>
+#include <iostream>
+#include <memory_resource>
+#include <random>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+#include "hash_map.h"
+
+/** Forwards to new/delete and keeps track of the bytes currently allocated */
+class counting_resource : public std::pmr::memory_resource
+{
+
+public:
+    size_t bytes = 0;
+
+protected:
+    void *do_allocate(size_t size, size_t alignment) override
+    {
+        bytes += size;
+        return std::pmr::new_delete_resource()->allocate(size, alignment);
+    }
+
+    void do_deallocate(void *p, size_t size, size_t alignment) override
+    {
+        bytes -= size;
+        std::pmr::new_delete_resource()->deallocate(p, size, alignment);
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override
+    {
+        return this == &other;
+    }
+};
+
+/** Returns the mean nanoseconds per lookup of keys in map */
+template <typename Map>
+static double time_lookups(const Map &map, const std::vector<uint64_t> &keys, uint64_t &checksum)
+{
+    auto start = std::chrono::steady_clock::now();
+    for (uint64_t key : keys)
+    {
+        checksum += map.get_value(key).value_or(1);
+    }
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / keys.size();
+}
+
+int main(int argc, char **argv)
+{
+    size_t entries = argc > 1 ? std::stoul(argv[1]) : 100000;
+    size_t lookups = argc > 2 ? std::stoul(argv[2]) : 200000;
+    unsigned seed = argc > 3 ? std::stoul(argv[3]) : 1;
+
+    std::mt19937_64 rng(seed);
+    std::vector<uint64_t> present(entries);
+    for (uint64_t &key : present)
+    {
+        key = rng();
+    }
+    std::vector<uint64_t> keys(lookups);
+    for (size_t i = 0; i < lookups; i++)
+    {
+        keys[i] = i % 2 == 0 ? present[rng() % entries] : rng();
+    }
+
+    counting_resource live_bytes;
+    hash_map<uint64_t, uint64_t> live(209, 0.7, 0.2, &live_bytes);
+    for (uint64_t key : present)
+    {
+        live.insert(key, key);
+    }
+
+    counting_resource frozen_bytes;
+    auto start = std::chrono::steady_clock::now();
+    frozen_hash_map<uint64_t, uint64_t> frozen = live.freeze(&frozen_bytes);
+    double build_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    uint64_t live_sum = 0;
+    uint64_t frozen_sum = 0;
+    double live_ns = time_lookups(live, keys, live_sum);
+    double frozen_ns = time_lookups(frozen, keys, frozen_sum);
+
+    std::cout << live.get_size() << " entries, " << lookups << " lookups (half hits), freeze took "
+              << build_ms << " ms" << std::endl;
+    std::cout << "live:   " << double(live_bytes.bytes) / live.get_size() << " bytes/entry, "
+              << live_ns << " ns/lookup" << std::endl;
+    std::cout << "frozen: " << double(frozen_bytes.bytes) / frozen.get_size() << " bytes/entry, "
+              << frozen_ns << " ns/lookup" << std::endl;
+    return live_sum == frozen_sum ? 0 : 1;
+}
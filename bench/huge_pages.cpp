@@ -0,0 +1,108 @@
+/**
+ * Random lookup throughput and dTLB load misses of a hash_map whose buckets and nodes come
+ * from 4 KB pages (the default resource) against one backed by 2 MB huge pages.
+ *
+ * Usage: huge_pages [entries] [lookups] [seed]
+ *
+ * The map never grows past 2039 buckets, so consecutive nodes of a chain are allocated
+ * about 2039 nodes apart and nearly every probe touches a different 4 KB page. dTLB
+ * misses are read with perf_event_open and reported as unavailable where that's blocked.
+ */
+#include <chrono>
+#include <iostream>
+#include <memory_resource>
+#include <random>
+#include <string>
+#include <vector>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#include "hash_map.h"
+#include "huge_page_resource.h"
+
+/** Opens a counter of this thread's dTLB read misses, or returns -1 */
+static int open_dtlb_counter()
+{
+    perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HW_CACHE;
+    attr.config = PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                  (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+/** Builds a map of `entries` keys in resource and times `lookups` random hits */
+static void run(const char *name, std::pmr::memory_resource *resource, size_t entries,
+                const std::vector<uint64_t> &probes)
+{
+    hash_map<uint64_t, uint64_t> map(209, 0.7, 0.2, resource);
+    for (uint64_t key = 0; key < entries; key++)
+    {
+        map.insert(key, key * 2);
+    }
+
+    int counter = open_dtlb_counter();
+    if (counter >= 0)
+    {
+        ioctl(counter, PERF_EVENT_IOC_RESET, 0);
+        ioctl(counter, PERF_EVENT_IOC_ENABLE, 0);
+    }
+
+    uint64_t checksum = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (uint64_t key : probes)
+    {
+        checksum += map.get_value(key).value_or(0);
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::string misses = "unavailable";
+    if (counter >= 0)
+    {
+        uint64_t count = 0;
+        ioctl(counter, PERF_EVENT_IOC_DISABLE, 0);
+        if (read(counter, &count, sizeof(count)) == sizeof(count))
+        {
+            misses = std::to_string(count) + " (" + std::to_string(double(count) / probes.size()) + " per lookup)";
+        }
+        close(counter);
+    }
+
+    std::cout << name << ": " << probes.size() / seconds / 1e6 << " M lookups/s, dTLB misses "
+              << misses << ", checksum " << checksum << std::endl;
+}
+
+int main(int argc, char **argv)
+{
+    size_t entries = argc > 1 ? std::stoul(argv[1]) : 200000;
+    size_t lookups = argc > 2 ? std::stoul(argv[2]) : 100000;
+    unsigned seed = argc > 3 ? std::stoul(argv[3]) : 1;
+
+    std::mt19937_64 rng(seed);
+    std::uniform_int_distribution<uint64_t> pick(0, entries - 1);
+    std::vector<uint64_t> probes(lookups);
+    for (uint64_t &key : probes)
+    {
+        key = pick(rng);
+    }
+
+    std::cout << entries << " entries, " << lookups << " random lookups" << std::endl;
+    run("4 KB pages ", std::pmr::new_delete_resource(), entries, probes);
+
+    huge_page_resource pages;
+    {
+        std::pmr::unsynchronized_pool_resource pool(&pages);
+        run("2 MB pages ", &pool, entries, probes);
+    }
+    std::cout << "huge page mappings: " << pages.get_hugetlb_mappings() << " MAP_HUGETLB, "
+              << pages.get_advised_mappings() << " MADV_HUGEPAGE" << std::endl;
+    return 0;
+}
@@ -0,0 +1,83 @@
+/**
+ * Lookups drawn from a Zipf distribution under each bucket_policy, reporting how many nodes
+ * a hit has to compare against on average and how many lookups reordered their chain.
+ *
+ * Usage: self_organize [keys] [lookups] [zipf exponent]
+ */
+#define HASH_MAP_STATS
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+#include "hash_map.h"
+
+static void measure(const char *name, bucket_policy policy, const std::vector<uint64_t> &keys,
+                    const std::vector<uint64_t> &lookups)
+{
+    hash_map<uint64_t, uint64_t> map(209, 0.7, 0.2);
+    for (uint64_t key : keys)
+    {
+        map.insert(key, key);
+    }
+    map.set_bucket_policy(policy);
+    hash_map_stats before = map.stats();
+
+    size_t hits = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (uint64_t key : lookups)
+    {
+        hits += map.contains(key);
+    }
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / lookups.size();
+    hash_map_stats after = map.stats();
+
+    std::cout << name << ": " << ns << " ns/lookup, "
+              << double(after.hit_probes - before.hit_probes) / (after.hits - before.hits)
+              << " nodes compared per hit, " << after.promotions - before.promotions << " promotions, "
+              << hits << " hits" << std::endl;
+}
+
+int main(int argc, char **argv)
+{
+    size_t count = argc > 1 ? std::stoul(argv[1]) : 20000;
+    size_t lookup_count = argc > 2 ? std::stoul(argv[2]) : 1000000;
+    double exponent = argc > 3 ? std::stod(argv[3]) : 1.1;
+
+    std::mt19937_64 rng(1);
+    std::vector<uint64_t> keys(count);
+    for (uint64_t &key : keys)
+    {
+        key = rng();
+    }
+
+    // rank r is drawn with probability proportional to 1 / r^exponent, by inverting the CDF
+    std::vector<double> cdf(count);
+    double total = 0;
+    for (size_t r = 0; r < count; r++)
+    {
+        total += 1 / std::pow(double(r + 1), exponent);
+        cdf[r] = total;
+    }
+    std::uniform_real_distribution<double> uniform(0, total);
+    std::vector<uint64_t> lookups(lookup_count);
+    for (uint64_t &lookup : lookups)
+    {
+        size_t rank = std::lower_bound(cdf.begin(), cdf.end(), uniform(rng)) - cdf.begin();
+        lookup = keys[std::min(rank, count - 1)];
+    }
+
+    // keys are inserted hottest first, which is the best case for a fixed chain, so insert
+    // them in random order instead
+    std::shuffle(keys.begin(), keys.end(), rng);
+
+    measure("fixed        ", bucket_policy::fixed, keys, lookups);
+    measure("move_to_front", bucket_policy::move_to_front, keys, lookups);
+    measure("transpose    ", bucket_policy::transpose, keys, lookups);
+    return 0;
+}
@@ -0,0 +1,90 @@
+/**
+ * Lookup and rehash cost with long string keys that share a prefix, so every key comparison
+ * runs the length of the key. Build it once as is and once with HASH_MAP_STORE_HASH to see
+ * what storing the hash in each node saves:
+ *
+ *     make benchmarks BENCH_FLAGS="-O2 -I. -DHASH_MAP_STORE_HASH"
+ *
+ * Usage: store_hash [entries] [lookups] [key length]
+ */
+#define HASH_MAP_STATS
+
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "hash_map.h"
+
+int main(int argc, char **argv)
+{
+    size_t entries = argc > 1 ? std::stoul(argv[1]) : 20000;
+    size_t lookups = argc > 2 ? std::stoul(argv[2]) : 200000;
+    size_t length = argc > 3 ? std::stoul(argv[3]) : 128;
+
+    // the same length and prefix for every key, differing only in the last few characters
+    auto key_text = [&](size_t i) {
+        std::string digits = std::to_string(i);
+        return std::string(length - digits.size(), 'k') + digits;
+    };
+
+    std::vector<std::string> keys(entries);
+    for (size_t i = 0; i < entries; i++)
+    {
+        keys[i] = key_text(i);
+    }
+    std::mt19937_64 rng(1);
+    std::vector<std::string> probes(lookups);
+    for (std::string &probe : probes)
+    {
+        probe = key_text(rng() % (entries * 2));
+    }
+
+    hash_map<std::string, size_t> map(209, 0.7, 0.2);
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < entries; i++)
+    {
+        map.insert(keys[i], i);
+    }
+    double build_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    hash_map_stats grown = map.stats();
+
+    size_t hits = 0;
+    start = std::chrono::steady_clock::now();
+    for (const std::string &probe : probes)
+    {
+        hits += map.contains(probe);
+    }
+    double lookup_ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / lookups;
+    hash_map_stats looked = map.stats();
+
+    // growing through every capacity and shrinking back rehashes each key several times
+    hash_map<std::string, size_t> cycled(209, 0.7, 0.2);
+    for (int round = 0; round < 50; round++)
+    {
+        for (size_t i = 0; i < std::min<size_t>(entries, 2000); i++)
+        {
+            cycled.insert(keys[i], i);
+        }
+        for (size_t i = 0; i < std::min<size_t>(entries, 2000); i++)
+        {
+            cycled.remove(keys[i]);
+        }
+    }
+    hash_map_stats resized = cycled.stats();
+
+#ifdef HASH_MAP_STORE_HASH
+    std::cout << "stored hashes, ";
+#else
+    std::cout << "no stored hashes, ";
+#endif
+    std::cout << entries << " keys of " << length << " bytes in " << map.get_capacity() << " buckets" << std::endl;
+    std::cout << "build: " << build_ms << " ms, of which " << grown.rehash_ns / 1e6 << " ms in "
+              << grown.rehashes << " rehashes" << std::endl;
+    std::cout << "lookup: " << lookup_ns << " ns (" << hits << " hits), "
+              << double(looked.probes - grown.probes) / lookups << " nodes visited per lookup" << std::endl;
+    std::cout << "resize: " << resized.rehash_ns / 1e6 << " ms in " << resized.rehashes
+              << " rehashes of up to 2000 keys" << std::endl;
+    return 0;
+}
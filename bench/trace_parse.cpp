@@ -0,0 +1,119 @@
+/**
+ * Time to parse a trace file with getline, substr and stoi/stof, the way test used to, against
+ * trace_reader's memory mapped, in place parse, and optionally against decoding the same
+ * trace in the binary format.
+ *
+ * Usage: trace_parse <trace file> [rounds] [binary trace]
+ *
+ * Make a large trace with tools/trace_gen first, and its binary form with tools/trace_convert.
+ * Each parser runs rounds times and the fastest round is reported, so all of them see their
+ * file in the page cache.
+ */
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <stdint.h>
+
+#include "binary_trace.h"
+#include "trace_reader.h"
+
+/** Parses the trace the way test's run_trace_file did, returning a checksum of what it read */
+static double parse_with_streams(const char *path, size_t &operations)
+{
+    std::ifstream input_file(path);
+    std::string current_line;
+    double checksum = 0;
+
+    operations = 0;
+    while (getline(input_file, current_line))
+    {
+        std::string delimeter = ":";
+        size_t delimeter_pos = current_line.find(delimeter);
+        std::string operation = current_line.substr(0, delimeter_pos);
+        std::string operation_args = current_line.substr(delimeter_pos + 1, std::string::npos);
+
+        if (operation == "Insert")
+        {
+            std::string comma = ",";
+            size_t comma_pos = operation_args.find(comma);
+            checksum += stoi(operation_args.substr(0, comma_pos));
+            checksum += stof(operation_args.substr(comma_pos + 1, std::string::npos));
+        }
+        else
+        {
+            checksum += stoi(operation_args);
+        }
+        operations++;
+    }
+    return checksum;
+}
+
+/** Parses the trace with Reader, returning a checksum of what it read */
+template <typename Reader>
+static double parse_with_reader(const char *path, size_t &operations)
+{
+    Reader reader(path);
+    trace_entry<int, float> entry;
+    double checksum = 0;
+
+    operations = 0;
+    while (reader.next(entry))
+    {
+        checksum += entry.key;
+        if (entry.op == trace_insert)
+        {
+            checksum += entry.value;
+        }
+        operations++;
+    }
+    return checksum;
+}
+
+template <typename Parse>
+static double fastest(Parse parse, const char *path, int rounds, size_t &operations, double &checksum)
+{
+    double best = 0;
+    for (int round = 0; round < rounds; round++)
+    {
+        auto start = std::chrono::steady_clock::now();
+        checksum = parse(path, operations);
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        best = round == 0 || ms < best ? ms : best;
+    }
+    return best;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        std::cerr << "Usage: trace_parse <trace file> [rounds]" << std::endl;
+        return 1;
+    }
+    int rounds = argc > 2 ? std::stoi(argv[2]) : 3;
+
+    size_t stream_operations;
+    size_t reader_operations;
+    double stream_checksum;
+    double reader_checksum;
+    double stream_ms = fastest(parse_with_streams, argv[1], rounds, stream_operations, stream_checksum);
+    double reader_ms = fastest(parse_with_reader<trace_reader<int, float>>, argv[1], rounds, reader_operations,
+                               reader_checksum);
+
+    std::cout << stream_operations << " operations" << std::endl;
+    std::cout << "getline/stoi: " << stream_ms << " ms, " << stream_ms * 1e6 / stream_operations << " ns/op" << std::endl;
+    std::cout << "trace_reader: " << reader_ms << " ms, " << reader_ms * 1e6 / reader_operations << " ns/op" << std::endl;
+    bool same = stream_operations == reader_operations && stream_checksum == reader_checksum;
+
+    if (argc > 3)
+    {
+        size_t binary_operations;
+        double binary_checksum;
+        double binary_ms = fastest(parse_with_reader<binary_trace_reader<int, float>>, argv[3], rounds,
+                                   binary_operations, binary_checksum);
+        std::cout << "binary:       " << binary_ms << " ms, " << binary_ms * 1e6 / binary_operations << " ns/op" << std::endl;
+        same = same && binary_operations == reader_operations && binary_checksum == reader_checksum;
+    }
+    return same ? 0 : 1;
+}
@@ -0,0 +1,64 @@
+/**
+ * Lookup cost of keys parsed out of a text buffer into a hash_map<std::string, V>, building a
+ * std::string for each one against passing the std::string_view straight through.
+ *
+ * Usage: transparent [entries] [lookups]
+ */
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "hash_map.h"
+
+/** Returns the mean nanoseconds per key of look(key) over the newline separated keys */
+template <typename Look>
+static double time_keys(const std::string &buffer, size_t count, Look look)
+{
+    auto start = std::chrono::steady_clock::now();
+    std::string_view rest = buffer;
+    while (!rest.empty())
+    {
+        size_t end = rest.find('\n');
+        look(rest.substr(0, end));
+        rest.remove_prefix(end + 1);
+    }
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / count;
+}
+
+int main(int argc, char **argv)
+{
+    size_t entries = argc > 1 ? std::stoul(argv[1]) : 10000;
+    size_t lookups = argc > 2 ? std::stoul(argv[2]) : 1000000;
+
+    // past the small string buffer, so building a std::string allocates
+    auto key_text = [](size_t i) { return "session-" + std::to_string(i) + "-0123456789abcdef"; };
+
+    hash_map<std::string, size_t> map(209, 0.7, 0.2);
+    for (size_t i = 0; i < entries; i++)
+    {
+        map.insert(key_text(i), i);
+    }
+
+    std::mt19937_64 rng(1);
+    std::string buffer;
+    for (size_t i = 0; i < lookups; i++)
+    {
+        buffer += key_text(rng() % (entries * 2));
+        buffer += '\n';
+    }
+
+    size_t built_hits = 0;
+    size_t viewed_hits = 0;
+    double built = time_keys(buffer, lookups, [&](std::string_view key) {
+        built_hits += map.contains(std::string(key));
+    });
+    double viewed = time_keys(buffer, lookups, [&](std::string_view key) { viewed_hits += map.contains(key); });
+
+    std::cout << lookups << " lookups of " << key_text(0).size() << "+ byte keys, " << built_hits << " hits" << std::endl;
+    std::cout << "contains(std::string(view)): " << built << " ns/lookup" << std::endl;
+    std::cout << "contains(view):              " << viewed << " ns/lookup" << std::endl;
+    return built_hits == viewed_hits ? 0 : 1;
+}
@@ -0,0 +1,182 @@
+#ifndef BINARY_TRACE_H
+#define BINARY_TRACE_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "trace_reader.h"
+
+/**
+ * A binary trace is a binary_trace_header followed by one record per operation:
+ *
+ *     op      one byte, the trace_op
+ *     key     the key
+ *     value   the value, for inserts only
+ *
+ * Integer keys and values are LEB128 varints, zigzag encoded first when signed, so small
+ * magnitudes take a byte or two. Floating point ones are stored as their raw little endian
+ * bytes. Records are numbered from 1 in place of line numbers.
+ */
+
+/** The number types a binary trace can hold keys and values as */
+enum binary_trace_type
+{
+    binary_trace_int32 = 1,
+    binary_trace_uint32,
+    binary_trace_int64,
+    binary_trace_uint64,
+    binary_trace_float,
+    binary_trace_double
+};
+
+/** The first bytes of every binary trace, in little endian order */
+struct binary_trace_header
+{
+    /** Always "hmtrace" */
+    char magic[7];
+
+    /** The format version, currently 1 */
+    uint8_t version;
+
+    /** The binary_trace_type keys and values are stored as */
+    uint8_t key_type;
+    uint8_t value_type;
+
+    uint8_t reserved[6];
+
+    /** The number of records, or 0 if the writer couldn't seek back to fill it in */
+    uint64_t count;
+};
+
+/** Return the binary_trace_type that T is stored as */
+template <typename T>
+constexpr uint8_t binary_trace_type_of();
+
+/**
+ * @brief Reads the header of the file at path
+ *
+ * @return
+ *  False if the file can't be read or doesn't start with a binary trace header
+ */
+bool read_binary_trace_header(const char *path, binary_trace_header &header);
+
+/**
+ * Writes a binary trace to a stdio file, buffering records so each costs a few stores.
+ * K and V must be 32 or 64 bit integers, float or double.
+ */
+template <typename K, typename V>
+class binary_trace_writer
+{
+
+public:
+    /**
+     * @brief Writes a header to file, which must be open for writing and stay open until
+     * finish() is called
+     */
+    explicit binary_trace_writer(FILE *file);
+
+    binary_trace_writer(const binary_trace_writer &other) = delete;
+    binary_trace_writer &operator=(const binary_trace_writer &other) = delete;
+
+    /**
+     * @brief Append the operation in entry. Its line number isn't stored
+     */
+    void write(const trace_entry<K, V> &entry);
+
+    /**
+     * @brief Flush the buffered records and, if the file can seek, fill in the header's
+     * record count
+     *
+     * @return
+     *  False if a write failed
+     */
+    bool finish();
+
+private:
+    /** Room for the longest record: an op byte and two ten byte varints */
+    static const size_t _max_record = 21;
+
+    void _flush();
+
+    template <typename T>
+    void _encode(T number);
+
+    FILE *_file;
+    uint64_t _count;
+    size_t _used;
+    bool _failed;
+    char _buffer[1 << 16];
+};
+
+/**
+ * Streams the records of a binary trace straight from a memory mapping, with the same
+ * interface as trace_reader. The header's types must match K and V.
+ */
+template <typename K, typename V>
+class binary_trace_reader
+{
+
+public:
+    /**
+     * @brief Maps the binary trace at path. Check is_open() before reading
+     */
+    explicit binary_trace_reader(const char *path);
+
+    binary_trace_reader(const binary_trace_reader &other) = delete;
+    binary_trace_reader &operator=(const binary_trace_reader &other) = delete;
+
+    /**
+     * @brief Return true if the file was mapped and has a header for keys of type K and
+     * values of type V
+     */
+    bool is_open() const;
+
+    /**
+     * @brief Read the next operation into entry
+     *
+     * @return
+     *  False at the end of the file or on a corrupt record, which failed() tells apart.
+     *  A file with fewer records than its header counts fails at the end
+     */
+    bool next(trace_entry<K, V> &entry);
+
+    /**
+     * @brief Return true if next() stopped on a record it couldn't decode
+     */
+    bool failed() const;
+
+    /**
+     * @brief Return the number of the record next() last read, counting from 1
+     */
+    size_t get_line_number() const;
+
+    /**
+     * @brief Go back to the first record
+     */
+    void rewind();
+
+private:
+    template <typename T>
+    bool _decode(T &number);
+
+    /** The trace file */
+    mapped_file _file;
+
+    /** Where the next record starts, and the end of the file */
+    const unsigned char *_cursor;
+    const unsigned char *_end;
+
+    /** The record count from the header, 0 if unknown */
+    uint64_t _count;
+
+    /** The number of the record last read */
+    size_t _line_number;
+
+    bool _open;
+    bool _failed;
+};
+
+/** See hash_list.h for an explanation of why this odd line of code is here */
+#include "binary_trace.hpp"
+
+#endif
@@ -0,0 +1,223 @@
+#include "binary_trace.h"
+
+#include <type_traits>
+#include <stddef.h>
+#include <string.h>
+
+static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__, "binary traces are read and written in place as little endian");
+
+template <typename T>
+constexpr uint8_t binary_trace_type_of()
+{
+    static_assert(std::is_arithmetic_v<T> && (sizeof(T) == 4 || sizeof(T) == 8),
+                  "binary traces hold 32 or 64 bit integers, float or double");
+    if constexpr (std::is_floating_point_v<T>)
+    {
+        return sizeof(T) == 4 ? binary_trace_float : binary_trace_double;
+    }
+    else if constexpr (std::is_signed_v<T>)
+    {
+        return sizeof(T) == 4 ? binary_trace_int32 : binary_trace_int64;
+    }
+    else
+    {
+        return sizeof(T) == 4 ? binary_trace_uint32 : binary_trace_uint64;
+    }
+}
+
+inline bool read_binary_trace_header(const char *path, binary_trace_header &header)
+{
+    FILE *file = fopen(path, "rb");
+    if (file == NULL)
+    {
+        return false;
+    }
+    bool read = fread(&header, sizeof(header), 1, file) == 1;
+    fclose(file);
+    return read && memcmp(header.magic, "hmtrace", sizeof(header.magic)) == 0 && header.version == 1;
+}
+
+template <typename K, typename V>
+binary_trace_writer<K, V>::binary_trace_writer(FILE *file) : _file(file), _count(0), _used(0), _failed(false)
+{
+    binary_trace_header header = {};
+    memcpy(header.magic, "hmtrace", sizeof(header.magic));
+    header.version = 1;
+    header.key_type = binary_trace_type_of<K>();
+    header.value_type = binary_trace_type_of<V>();
+    memcpy(_buffer, &header, sizeof(header));
+    _used = sizeof(header);
+}
+
+template <typename K, typename V>
+void binary_trace_writer<K, V>::write(const trace_entry<K, V> &entry)
+{
+    if (sizeof(_buffer) - _used < _max_record)
+    {
+        _flush();
+    }
+    _buffer[_used++] = static_cast<char>(entry.op);
+    _encode(entry.key);
+    if (entry.op == trace_insert)
+    {
+        _encode(entry.value);
+    }
+    _count++;
+}
+
+template <typename K, typename V>
+bool binary_trace_writer<K, V>::finish()
+{
+    _flush();
+
+    // pipes can't seek, and readers don't need the count, so leave it 0 there
+    if (fseek(_file, offsetof(binary_trace_header, count), SEEK_SET) == 0)
+    {
+        _failed |= fwrite(&_count, sizeof(_count), 1, _file) != 1;
+        _failed |= fseek(_file, 0, SEEK_END) != 0;
+    }
+    _failed |= fflush(_file) != 0;
+    return !_failed;
+}
+
+template <typename K, typename V>
+void binary_trace_writer<K, V>::_flush()
+{
+    _failed |= _used != 0 && fwrite(_buffer, 1, _used, _file) != _used;
+    _used = 0;
+}
+
+template <typename K, typename V>
+template <typename T>
+void binary_trace_writer<K, V>::_encode(T number)
+{
+    if constexpr (std::is_floating_point_v<T>)
+    {
+        memcpy(_buffer + _used, &number, sizeof(number));
+        _used += sizeof(number);
+    }
+    else
+    {
+        uint64_t bits = static_cast<uint64_t>(number);
+        if constexpr (std::is_signed_v<T>)
+        {
+            bits = (bits << 1) ^ static_cast<uint64_t>(static_cast<int64_t>(number) >> 63);
+        }
+        while (bits >= 0x80)
+        {
+            _buffer[_used++] = static_cast<char>(bits | 0x80);
+            bits >>= 7;
+        }
+        _buffer[_used++] = static_cast<char>(bits);
+    }
+}
+
+template <typename K, typename V>
+binary_trace_reader<K, V>::binary_trace_reader(const char *path)
+    : _file(path), _cursor(NULL), _end(NULL), _count(0), _line_number(0), _open(false), _failed(false)
+{
+    binary_trace_header header;
+    if (_file.get_size() < sizeof(header))
+    {
+        return;
+    }
+    memcpy(&header, _file.get_data(), sizeof(header));
+    _open = memcmp(header.magic, "hmtrace", sizeof(header.magic)) == 0 && header.version == 1 &&
+            header.key_type == binary_trace_type_of<K>() && header.value_type == binary_trace_type_of<V>();
+    _count = header.count;
+
+    _end = reinterpret_cast<const unsigned char *>(_file.get_data() + _file.get_size());
+    rewind();
+}
+
+template <typename K, typename V>
+bool binary_trace_reader<K, V>::is_open() const
+{
+    return _open;
+}
+
+template <typename K, typename V>
+bool binary_trace_reader<K, V>::next(trace_entry<K, V> &entry)
+{
+    if (!_open || _failed)
+    {
+        return false;
+    }
+
+    if (_cursor == _end)
+    {
+        // a file cut off between two records would otherwise look complete
+        _failed = _count != 0 && _line_number != _count;
+        return false;
+    }
+
+    _line_number++;
+    unsigned char op = *_cursor++;
+    if (op >= trace_op_count || !_decode(entry.key) || (op == trace_insert && !_decode(entry.value)))
+    {
+        _failed = true;
+        return false;
+    }
+
+    entry.op = static_cast<trace_op>(op);
+    entry.line_number = _line_number;
+    return true;
+}
+
+template <typename K, typename V>
+bool binary_trace_reader<K, V>::failed() const
+{
+    return _failed;
+}
+
+template <typename K, typename V>
+size_t binary_trace_reader<K, V>::get_line_number() const
+{
+    return _line_number;
+}
+
+template <typename K, typename V>
+void binary_trace_reader<K, V>::rewind()
+{
+    _cursor = _open ? reinterpret_cast<const unsigned char *>(_file.get_data()) + sizeof(binary_trace_header) : _end;
+    _line_number = 0;
+    _failed = false;
+}
+
+template <typename K, typename V>
+template <typename T>
+bool binary_trace_reader<K, V>::_decode(T &number)
+{
+    if constexpr (std::is_floating_point_v<T>)
+    {
+        if (static_cast<size_t>(_end - _cursor) < sizeof(number))
+        {
+            return false;
+        }
+        memcpy(&number, _cursor, sizeof(number));
+        _cursor += sizeof(number);
+    }
+    else
+    {
+        uint64_t bits = 0;
+        for (int shift = 0;; shift += 7)
+        {
+            if (_cursor == _end || shift > 63)
+            {
+                return false;
+            }
+            unsigned char byte = *_cursor++;
+            bits |= static_cast<uint64_t>(byte & 0x7f) << shift;
+            if (byte < 0x80)
+            {
+                break;
+            }
+        }
+        if constexpr (std::is_signed_v<T>)
+        {
+            bits = (bits >> 1) ^ (0 - (bits & 1));
+        }
+        number = static_cast<T>(bits);
+    }
+    return true;
+}
@@ -0,0 +1,85 @@
+#ifndef FROZEN_HASH_MAP_H
+#define FROZEN_HASH_MAP_H
+
+#include <functional>
+#include <memory_resource>
+#include <optional>
+#include <utility>
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * An immutable map built by hash_map::freeze. Keys are placed with a minimal perfect hash
+ * function in the style of CHD (compress, hash and displace): every key hashes to one of
+ * about n / 4 groups, and each group stores the displacement that sends all of its keys to
+ * distinct slots of an array with exactly n entries. A lookup is therefore one hash, one
+ * displacement load and one key comparison, with no empty buckets or chain pointers.
+ */
+template <typename K, typename V>
+class frozen_hash_map
+{
+
+public:
+    /**
+     * @brief Builds the map from pairs with distinct keys
+     *
+     * @param pairs
+     *  The key/value pairs to hold
+     * @param resource
+     *  Where the arrays are allocated from
+     * @throws std::invalid_argument
+     *  If two keys have the same std::hash value, which no displacement can separate
+     */
+    frozen_hash_map(const std::vector<std::pair<K, V>> &pairs,
+                    std::pmr::memory_resource *resource = std::pmr::get_default_resource());
+
+    /**
+     * @brief Return an optional containing the value associated with the specified key.
+     * If the key isn't in the map return an empty optional.
+     */
+    std::optional<V> get_value(K key) const;
+
+    /**
+     * @brief Return the number of key/value pairs in the map
+     */
+    size_t get_size() const;
+
+    /**
+     * @brief Return the number of bytes the map's arrays take up
+     */
+    size_t get_bytes() const;
+
+private:
+    /** The average number of keys per displacement group */
+    static constexpr size_t _keys_per_group = 4;
+
+    struct _entry
+    {
+        K key;
+        V value;
+    };
+
+    /** Scrambles a hash so the group and slot hashes look independent */
+    static uint64_t _mix(uint64_t x);
+
+    /** Returns the group a key with hash h belongs to */
+    size_t _group(uint64_t h) const;
+
+    /** Returns the slot a key with hash h goes to when its group has displacement d */
+    size_t _slot(uint64_t h, uint32_t d) const;
+
+    /** The key/value pairs, each at the slot the perfect hash sends its key to */
+    std::pmr::vector<_entry> _entries;
+
+    /** The displacement chosen for each group */
+    std::pmr::vector<uint32_t> _displacements;
+
+    /** Built in hashing function for type K */
+    std::hash<K> _hash;
+};
+
+/** See hash_list.h for an explanation of why this odd line of code is here */
+#include "frozen_hash_map.hpp"
+
+#endif
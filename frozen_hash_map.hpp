@@ -0,0 +1,160 @@
+#include "frozen_hash_map.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+template <typename K, typename V>
+frozen_hash_map<K, V>::frozen_hash_map(const std::vector<std::pair<K, V>> &pairs,
+                                       std::pmr::memory_resource *resource)
+    : _entries(resource), _displacements(resource)
+{
+    size_t n = pairs.size();
+    if (n == 0)
+    {
+        return;
+    }
+    _entries.resize(n);
+    _displacements.assign((n + _keys_per_group - 1) / _keys_per_group, 0);
+
+    // bucket the keys by group, remembering each key's full hash
+    std::vector<uint64_t> hashes(n);
+    std::vector<size_t> group_start(_displacements.size() + 1, 0);
+    for (size_t i = 0; i < n; i++)
+    {
+        hashes[i] = _hash(pairs[i].first);
+        group_start[_group(hashes[i]) + 1]++;
+    }
+    for (size_t g = 0; g < _displacements.size(); g++)
+    {
+        group_start[g + 1] += group_start[g];
+    }
+    std::vector<size_t> members(n);
+    std::vector<size_t> fill(group_start.begin(), group_start.end() - 1);
+    for (size_t i = 0; i < n; i++)
+    {
+        members[fill[_group(hashes[i])]++] = i;
+    }
+
+    // place the biggest groups first, while most slots are still free
+    std::vector<size_t> order(_displacements.size());
+    for (size_t g = 0; g < order.size(); g++)
+    {
+        order[g] = g;
+    }
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return group_start[a + 1] - group_start[a] > group_start[b + 1] - group_start[b];
+    });
+
+    std::vector<size_t> slot_of(n);
+    std::vector<bool> taken(n, false);
+    std::vector<size_t> tried;
+    for (size_t g : order)
+    {
+        size_t begin = group_start[g];
+        size_t end = group_start[g + 1];
+        if (begin == end)
+        {
+            break;
+        }
+
+        for (size_t a = begin; a < end; a++)
+        {
+            for (size_t b = a + 1; b < end; b++)
+            {
+                if (hashes[members[a]] == hashes[members[b]])
+                {
+                    throw std::invalid_argument("frozen_hash_map keys with equal hashes");
+                }
+            }
+        }
+
+        for (uint32_t d = 0;; d++)
+        {
+            // try d, undoing the slots it took if any key of the group lands on a taken one
+            tried.clear();
+            for (size_t m = begin; m < end; m++)
+            {
+                size_t slot = _slot(hashes[members[m]], d);
+                if (taken[slot])
+                {
+                    break;
+                }
+                taken[slot] = true;
+                tried.push_back(slot);
+            }
+            if (tried.size() == end - begin)
+            {
+                _displacements[g] = d;
+                for (size_t m = begin; m < end; m++)
+                {
+                    slot_of[members[m]] = tried[m - begin];
+                }
+                break;
+            }
+            for (size_t slot : tried)
+            {
+                taken[slot] = false;
+            }
+        }
+    }
+
+    for (size_t i = 0; i < n; i++)
+    {
+        _entries[slot_of[i]] = {pairs[i].first, pairs[i].second};
+    }
+}
+
+template <typename K, typename V>
+std::optional<V> frozen_hash_map<K, V>::get_value(K key) const
+{
+    if (_entries.empty())
+    {
+        return {};
+    }
+
+    uint64_t h = _hash(key);
+    const _entry &candidate = _entries[_slot(h, _displacements[_group(h)])];
+
+    // a missing key still lands on some slot, so the key has to be checked
+    if (!(candidate.key == key))
+    {
+        return {};
+    }
+    return candidate.value;
+}
+
+template <typename K, typename V>
+size_t frozen_hash_map<K, V>::get_size() const
+{
+    return _entries.size();
+}
+
+template <typename K, typename V>
+size_t frozen_hash_map<K, V>::get_bytes() const
+{
+    return _entries.size() * sizeof(_entry) + _displacements.size() * sizeof(uint32_t);
+}
+
+template <typename K, typename V>
+uint64_t frozen_hash_map<K, V>::_mix(uint64_t x)
+{
+    // the splitmix64 finalizer
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x;
+}
+
+template <typename K, typename V>
+size_t frozen_hash_map<K, V>::_group(uint64_t h) const
+{
+    return _mix(h) % _displacements.size();
+}
+
+template <typename K, typename V>
+size_t frozen_hash_map<K, V>::_slot(uint64_t h, uint32_t d) const
+{
+    return _mix(h + (uint64_t(d) + 1) * 0x9e3779b97f4a7c15ULL) % _entries.size();
+}
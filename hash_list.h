@@ -1,9 +1,14 @@
 #ifndef HASH_LIST_H
 #define HASH_LIST_H
 
+#include <vector>
+#include <memory_resource>
 #include <optional>
+#include <type_traits>
+#include <utility>
 #include <stddef.h>
 #include <stdlib.h>
+#include <stdint.h>
 
 template <typename K, typename V>
 struct node
@@ -16,8 +21,90 @@ struct node
 
     /** a pointer to the next node */
     node *next;
+
+#ifdef HASH_MAP_STORE_HASH
+    /** The full hash of key, set by the hash_map the node is linked into */
+    size_t hash = 0;
+#endif
+
+#ifdef HASH_MAP_CACHE
+    /** The neighbours of this node in the owning hash_map's CLOCK ring */
+    node *clock_prev = NULL;
+    node *clock_next = NULL;
+
+    /** Set when the node is read and cleared when the CLOCK hand passes over it */
+    bool referenced = false;
+#endif
+
+#ifdef HASH_MAP_TTL
+    /** The steady clock millisecond the node expires at, or 0 if it never expires */
+    uint64_t expires_at = 0;
+
+    /** The next node in the same timer wheel slot */
+    node *timer_next = NULL;
+
+    /** The link that points to this node in its timer wheel slot, or NULL if unscheduled */
+    node **timer_pprev = NULL;
+#endif
+};
+
+/**
+ * Owns a single node that has been extracted from a hash_list or hash_map, so it can be
+ * inserted into another one without freeing and reallocating it or copying its key and
+ * value. Frees the node with the resource it came from if it is never inserted.
+ */
+template <typename K, typename V>
+class node_handle
+{
+
+public:
+    /** Create an empty handle */
+    node_handle();
+
+    /** Take ownership of owned, which was allocated from resource */
+    node_handle(node<K, V> *owned, std::pmr::memory_resource *resource);
+
+    node_handle(node_handle &&other);
+    node_handle &operator=(node_handle &&other);
+
+    node_handle(const node_handle &other) = delete;
+    node_handle &operator=(const node_handle &other) = delete;
+
+    /** Free the node if the handle still owns one */
+    ~node_handle();
+
+    /** Return true if the handle doesn't own a node */
+    bool empty() const;
+
+    /** Return the key of the owned node. The handle must not be empty */
+    K &key() const;
+
+    /** Return the value of the owned node. The handle must not be empty */
+    V &value() const;
+
+    /** Return the resource the owned node was allocated from */
+    std::pmr::memory_resource *get_resource() const;
+
+    /** Give up ownership of the node and return it, leaving the handle empty */
+    node<K, V> *release();
+
+private:
+    /** The node the handle owns, or NULL */
+    node<K, V> *owned;
+
+    /** Where owned was allocated from */
+    std::pmr::memory_resource *resource;
 };
 
+/**
+ * A list of nodes. Once a list reaches treeify_at nodes, and K can be ordered with <, its
+ * chain is sorted by key and indexed by a two level tree: an array of blocks, each a sorted
+ * array of up to block_size node pointers. Lookups stay O(log n) however many keys land in
+ * the list, for around 8 to 16 bytes a node. Since the chain is in key order, the link to a
+ * node is its predecessor's next, so the tree needs no upkeep when links change. New nodes
+ * go to their place in key order rather than where they were linked. The tree is dropped when
+ * the list shrinks to untreeify_at
+ */
 template <typename K, typename V>
 class hash_list
 {
@@ -26,10 +113,19 @@ public:
     /** Create empty list. Should set head to null and size to 0 */
     hash_list();
 
-    /** Copy constructor for hash_list */
+    /** Create empty list whose nodes are allocated from resource */
+    explicit hash_list(std::pmr::memory_resource *resource);
+
+    /**
+     * Copy constructor for hash_list. Like the std::pmr containers, the copy uses the
+     * default resource rather than other's, since it may outlive other's arena
+     */
     hash_list(const hash_list &other);
 
-    /** Copy assignment operator for hash_list */
+    /** Copy other into a list whose nodes are allocated from resource */
+    hash_list(const hash_list &other, std::pmr::memory_resource *resource);
+
+    /** Copy assignment operator for hash_list. The list keeps its own resource */
     hash_list &operator=(const hash_list &other);
 
     /**
@@ -80,7 +176,215 @@ public:
     /** Returns true if the iterator is NULL */
     bool iter_at_end();
 
+    /**
+     * Return a pointer to the node containing the specified key, or NULL if the key isn't
+     * in the list. probes is incremented once for every node whose key was compared.
+     * key may be of any type that compares equal to K with ==
+     */
+    template <typename Q>
+    node<K, V> *find_node(const Q &key, size_t &probes) const;
+
+    /**
+     * Return the address of the link (head or some node's next) that points to the node
+     * containing the specified key. If the key isn't in the list this is the address of the
+     * NULL link at the end of the list, which is where a new node for the key belongs.
+     * probes is incremented once for every node whose key was compared, or once for a
+     * lookup in a treeified list
+     */
+    template <typename Q>
+    node<K, V> **find_link(const Q &key, size_t &probes);
+
+    /**
+     * find_node and find_link for a list owned by a hash_map, where hash is key's full hash.
+     * With HASH_MAP_STORE_HASH, nodes whose stored hash differs are passed over without
+     * comparing keys, though probes still counts them
+     */
+    template <typename Q>
+    node<K, V> *find_node(const Q &key, size_t hash, size_t &probes) const;
+
+    template <typename Q>
+    node<K, V> **find_link(const Q &key, size_t hash, size_t &probes);
+
+    /**
+     * Make the link returned by find_link point to new_node. The list takes ownership. A
+     * treeified list links the node at its place in key order instead
+     */
+    void link_at(node<K, V> **link, node<K, V> *new_node);
+
+    /** Detach and return the node pointed to by the link returned by find_link */
+    node<K, V> *unlink_at(node<K, V> **link);
+
+    /**
+     * Move the node that link points to to the front of the list, or one place nearer it
+     * if to_front is false. Returns true if the node moved, which it doesn't if it is
+     * already first or the list is treeified
+     */
+    bool promote(node<K, V> **link, bool to_front);
+
+    /** Return the first node of the list, or NULL if the list is empty */
+    node<K, V> *front() const;
+
+    /** Return the address of the link to the first node, for walks that unlink as they go */
+    node<K, V> **front_link();
+
+    /**
+     * Unlink every node for which pred(node) returns true in a single pass. The unlinked
+     * nodes are pushed onto the front of the chain `unlinked` (linked through next), and the
+     * new front of that chain is returned for the caller to free
+     */
+    template <typename Pred>
+    node<K, V> *unlink_if(Pred pred, node<K, V> *unlinked);
+
+    /** Add a node to the front of the list. The list takes ownership */
+    void push_front(node<K, V> *new_node);
+
+    /** Detach and return the first node of the list, or NULL if the list is empty */
+    node<K, V> *pop_front();
+
+    /**
+     * Remove the node containing the specified key from the list and return a handle that
+     * owns it, or an empty handle if the key isn't in the list
+     */
+    node_handle<K, V> extract(const K &key);
+
+    /**
+     * Append the node owned by handle to the list and return true, leaving handle empty.
+     * If the key is already in the list nothing changes, handle keeps its node and false
+     * is returned. A node from a different resource is copied into this list's resource
+     */
+    bool insert(node_handle<K, V> &&handle);
+
+    /** Return the resource the list allocates and frees its nodes with */
+    std::pmr::memory_resource *get_resource() const;
+
+    /** Return true if the list currently indexes its nodes in a tree */
+    bool is_treeified() const;
+
+    /** Return the number of bytes the list's tree currently holds, 0 if it has none */
+    size_t get_index_bytes() const;
+
+    /** Return the number of bytes allocated for trees over the list's lifetime */
+    size_t get_index_bytes_allocated() const;
+
 private:
+    /** Lists this long are indexed by a tree */
+    static constexpr size_t treeify_at = 32;
+
+    /** Treeified lists this short go back to being plain lists */
+    static constexpr size_t untreeify_at = 16;
+
+    /** True if a < b compiles for an A a and a B b */
+    template <typename A, typename B, typename = void>
+    struct less_comparable : std::false_type
+    {
+    };
+
+    template <typename A, typename B>
+    struct less_comparable<A, B, std::void_t<decltype(std::declval<const A &>() < std::declval<const B &>())>>
+        : std::true_type
+    {
+    };
+
+    /** The most nodes a block of the tree holds. A full block is split in two */
+    static constexpr size_t block_size = 64;
+
+    /** A run of a treeified list's nodes, in key order */
+    struct index_block
+    {
+        size_t count;
+        node<K, V> *nodes[block_size];
+    };
+
+    /** Passes the tree's allocations on to the list's resource, counting their bytes */
+    class index_resource : public std::pmr::memory_resource
+    {
+
+    public:
+        explicit index_resource(std::pmr::memory_resource *upstream) : upstream(upstream) {}
+
+        std::pmr::memory_resource *upstream;
+
+        /** The bytes currently allocated, and allocated over the tree's lifetime */
+        size_t bytes = 0;
+        size_t allocated = 0;
+
+    protected:
+        void *do_allocate(size_t size, size_t alignment) override
+        {
+            bytes += size;
+            allocated += size;
+            return upstream->allocate(size, alignment);
+        }
+
+        void do_deallocate(void *p, size_t size, size_t alignment) override
+        {
+            bytes -= size;
+            upstream->deallocate(p, size, alignment);
+        }
+
+        bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override
+        {
+            return this == &other;
+        }
+    };
+
+    /** What a treeified list keeps alongside its chain */
+    struct tree_index
+    {
+        explicit tree_index(std::pmr::memory_resource *resource) : memory(resource), blocks(&memory) {}
+
+        ~tree_index()
+        {
+            for (index_block *block : blocks)
+            {
+                memory.deallocate(block, sizeof(index_block), alignof(index_block));
+            }
+        }
+
+        /** Where the blocks and the array of them are allocated from */
+        index_resource memory;
+
+        /** The blocks in key order. None is empty */
+        std::pmr::vector<index_block *> blocks;
+
+        /** The last node of the chain */
+        node<K, V> *last;
+    };
+
+    /**
+     * Find where key is or belongs in the tree: block and slot are set to the first node whose
+     * key isn't less than key, which may be one past the end of the block. Returns true if
+     * that node's key is key
+     */
+    template <typename Q>
+    bool tree_search(const Q &key, size_t &block, size_t &slot) const;
+
+    /** Returns the link that points to the node at block and slot */
+    node<K, V> **tree_link_to(size_t block, size_t slot);
+
+    /**
+     * Returns the link to key's node, or the NULL link at the end of the chain if key isn't
+     * in the list. Returns NULL if the list isn't treeified or key can't be ordered against K,
+     * so the chain must be walked
+     */
+    template <typename Q>
+    node<K, V> **tree_find(const Q &key) const;
+
+    /** Link a node into a treeified list at its place in key order, and index it */
+    void tree_link(node<K, V> *linked);
+
+    /** Drop a node unlink_at just unlinked, untreeifying the list if it got short */
+    void tree_unlink(node<K, V> *removed);
+
+    /**
+     * Sort the chain by key and build the tree over it, if the list is long enough and K can
+     * be ordered
+     */
+    void treeify();
+
+    /** Free the tree, if any */
+    void untreeify();
+
     /** The number of nodes in the list */
     size_t size;
 
@@ -89,6 +393,15 @@ private:
 
     /** The node that the iterator is currently pointing to */
     node<K,V> *iter_ptr;
+
+    /** Where the nodes are allocated from. Never NULL */
+    std::pmr::memory_resource *resource;
+
+    /** The index of a treeified list, or NULL. Allocated from resource */
+    tree_index *tree;
+
+    /** The bytes allocated by trees the list has since freed */
+    size_t freed_index_bytes;
 };
 
 /**
@@ -4,35 +4,63 @@
 using namespace std;
 
 template <typename K, typename V>
-node<K, V> *_insnode(K key, V value);
+node<K, V> *_insnode(std::pmr::memory_resource *resource, K key, V value);
+
+template <typename K, typename V, typename KArg, typename... Args>
+node<K, V> *_emplacenode(std::pmr::memory_resource *resource, KArg &&key, Args &&...args);
+
+template <typename K, typename V>
+node<K, V> *_copynode(std::pmr::memory_resource *resource, const node<K, V> &other);
+
+template <typename K, typename V>
+void _delnode(std::pmr::memory_resource *resource, node<K, V> *oldNode);
 
 // Constructor
 template <typename K, typename V>
-hash_list<K, V>::hash_list()
+hash_list<K, V>::hash_list() : hash_list(std::pmr::get_default_resource())
+{
+}
+
+template <typename K, typename V>
+hash_list<K, V>::hash_list(std::pmr::memory_resource *resource)
 {
     size = 0;
     //node <key,value> &head = node<key,value> *head;
     head = NULL;
     iter_ptr = NULL;
-    
+    this->resource = resource;
+    tree = NULL;
+    freed_index_bytes = 0;
 }
 
 // Copy Constructor
 template <typename K, typename V>
 hash_list<K, V>::hash_list(const hash_list<K, V> &other)
+    : hash_list(other, std::pmr::get_default_resource())
+{
+}
+
+template <typename K, typename V>
+hash_list<K, V>::hash_list(const hash_list<K, V> &other, std::pmr::memory_resource *resource)
 {
      size = 0;
      head = NULL;
      iter_ptr = NULL;
-     //recreate new linked_list
-     node<K, V>* cnode = other.head;
-    
-     while(cnode != NULL)
+     this->resource = resource;
+     tree = NULL;
+     freed_index_bytes = 0;
+     //recreate new linked_list, cloning whole nodes so any per-node state comes along
+     node<K, V>** tail = &head;
+
+     for(node<K, V>* cnode = other.head; cnode != NULL; cnode = cnode->next)
      {
-        insert(cnode->key, cnode->value);
-        cnode = cnode->next;
+        *tail = _copynode(resource, *cnode);
+        tail = &(*tail)->next;
+        size += 1;
      }
-    
+     *tail = NULL;
+     treeify();
+
 }
 
 // Assignment operator
@@ -44,12 +72,16 @@ hash_list<K, V> &hash_list<K, V>::operator=(const hash_list<K, V> &other)
         return *this;
     }
     
-    hash_list<K, V> Tempobject = hash_list(other);
+    hash_list<K, V> Tempobject = hash_list(other, resource);
     node<K, V>* ptr = NULL;
     ptr = this -> head;
     this -> head = Tempobject.head;
     this -> size = Tempobject.size;
     Tempobject.head= ptr;
+
+    // both trees hold links into their own list's head, so neither can change hands
+    untreeify();
+    treeify();
     return *this;
    
 }
@@ -58,143 +90,666 @@ hash_list<K, V> &hash_list<K, V>::operator=(const hash_list<K, V> &other)
 template <typename K, typename V>
 void hash_list<K, V>::insert(K key, V value)
 {
-    // Find the head node, set current to head
-    node<K, V>* current = head;
-    node<K, V>* previousNode = head;
-    bool hasWritten = false;
-
-    // Check if first, update head if is
-    if (current == NULL)
+    // update the value of an existing key, otherwise append a new node at the end
+    size_t probes = 0;
+    node<K, V> **link = find_link(key, probes);
+    if (*link != NULL)
     {
-        //// std::cout << "(INSERT) head is null, writing here" << std::endl;
-        current = _insnode(key, value);
-        head = current;
-        size += 1;
+        (*link)->value = value;
         return;
     }
+    link_at(link, _insnode(resource, key, value));
+}
 
-    // Traverse list
+// Get Value Function
+template <typename K, typename V>
+std::optional<V> hash_list<K, V>::get_value(K key) const
+{
+    node<K, V>* current = head;
     while (current != NULL)
     {
-
-        // If you find a key that matches, update value and bool
+        // finds
         if (current->key == key)
         {
-            //// std::cout << "(INSERT) Found duplicate, overwriting" << std::endl;
-            current->value = value;
-            hasWritten = true;
+            // std::cout << "(GETVALUE) Value: " << current->value << std::endl;
+            return current->value;
         }
-        if (current != NULL)
+        current = current->next;
+    }
+    // std::cout << "(GETVALUE) Did not Find" << std::endl;
+    return {};
+}
+template <typename K, typename V>
+node<K, V>* _insnode(std::pmr::memory_resource *resource, K key, V value)
+{
+    // create node
+    return _emplacenode<K, V>(resource, std::move(key), std::move(value));
+}
+
+template <typename K, typename V, typename KArg, typename... Args>
+node<K, V>* _emplacenode(std::pmr::memory_resource *resource, KArg &&key, Args &&...args)
+{
+    // build the key and value straight into the node, leaving the other fields at their defaults
+    void *memory = resource->allocate(sizeof(node<K, V>), alignof(node<K, V>));
+    try
+    {
+        return new (memory) node<K, V>{K(std::forward<KArg>(key)), V(std::forward<Args>(args)...), NULL};
+    }
+    catch (...)
+    {
+        resource->deallocate(memory, sizeof(node<K, V>), alignof(node<K, V>));
+        throw;
+    }
+}
+
+template <typename K, typename V>
+node<K, V>* _copynode(std::pmr::memory_resource *resource, const node<K, V> &other)
+{
+    return new (resource->allocate(sizeof(node<K, V>), alignof(node<K, V>))) node<K, V>(other);
+}
+
+template <typename K, typename V>
+void _delnode(std::pmr::memory_resource *resource, node<K, V> *oldNode)
+{
+    oldNode->~node<K, V>();
+    resource->deallocate(oldNode, sizeof(node<K, V>), alignof(node<K, V>));
+}
+
+template <typename K, typename V>
+bool hash_list<K, V>::remove(K key)
+{
+    size_t probes = 0;
+    node<K, V> **link = find_link(key, probes);
+    if (*link == NULL)
+    {
+        return false;
+    }
+    _delnode(resource, unlink_at(link));
+    return true;
+}
+
+template <typename K, typename V>
+size_t hash_list<K, V>::get_size() const
+{
+    // std::cout << size << std::endl;
+    return size;
+}
+
+template <typename K, typename V>
+hash_list<K, V>::~hash_list()
+{
+    node<K, V>* current;
+    untreeify();
+
+    while (head != NULL)
+    {
+        current = head;
+        // std::cout << current->key << std::endl;
+        head = head->next;
+        _delnode(resource, current);
+    }
+
+    //// std::cout << "(DESTRUCTOR)  Destruct Finished" << std::endl;
+}
+
+template <typename K, typename V>
+template <typename Q>
+node<K, V> *hash_list<K, V>::find_node(const Q &key, size_t &probes) const
+{
+    if (node<K, V> **link = tree_find(key))
+    {
+        probes++;
+        return *link;
+    }
+
+    node<K, V> *current = head;
+    while (current != NULL)
+    {
+        probes++;
+        if (current->key == key)
         {
-            previousNode = current;
+            return current;
         }
         current = current->next;
     }
+    return NULL;
+}
 
-    // If no values have been updated (new key), make a new node and append to end
-    if (hasWritten == false)
+template <typename K, typename V>
+template <typename Q>
+node<K, V> **hash_list<K, V>::find_link(const Q &key, size_t &probes)
+{
+    if (node<K, V> **link = tree_find(key))
     {
-        //// std::cout << "(INSERT) Appending node" << std::endl;
-        current = _insnode(key, value);
-        previousNode->next = current;
-        size += 1;
+        probes++;
+        return link;
     }
 
-    return;
+    node<K, V> **link = &head;
+    while (*link != NULL)
+    {
+        probes++;
+        if ((*link)->key == key)
+        {
+            return link;
+        }
+        link = &(*link)->next;
+    }
+    return link;
 }
 
-// Get Value Function
 template <typename K, typename V>
-std::optional<V> hash_list<K, V>::get_value(K key) const
+template <typename Q>
+node<K, V> *hash_list<K, V>::find_node(const Q &key, size_t hash, size_t &probes) const
 {
-    node<K, V>* current = head;
+#ifdef HASH_MAP_STORE_HASH
+    if (node<K, V> **link = tree_find(key))
+    {
+        probes++;
+        return *link;
+    }
+
+    node<K, V> *current = head;
     while (current != NULL)
     {
-        // finds
-        if (current->key == key)
+        probes++;
+        if (current->hash == hash && current->key == key)
         {
-            // std::cout << "(GETVALUE) Value: " << current->value << std::endl;
-            return current->value;
+            return current;
         }
         current = current->next;
     }
-    // std::cout << "(GETVALUE) Did not Find" << std::endl;
-    return {};
+    return NULL;
+#else
+    (void)hash;
+    return find_node(key, probes);
+#endif
 }
+
 template <typename K, typename V>
-node<K, V>* _insnode(K key, V value)
+template <typename Q>
+node<K, V> **hash_list<K, V>::find_link(const Q &key, size_t hash, size_t &probes)
 {
-    // create node
-    node<K, V>* newNode = new (node<K, V>);
-    newNode->key = key;
-    newNode->value = value;
-    newNode->next = NULL;
-    return newNode;
+#ifdef HASH_MAP_STORE_HASH
+    if (node<K, V> **link = tree_find(key))
+    {
+        probes++;
+        return link;
+    }
+
+    node<K, V> **link = &head;
+    while (*link != NULL)
+    {
+        probes++;
+        if ((*link)->hash == hash && (*link)->key == key)
+        {
+            return link;
+        }
+        link = &(*link)->next;
+    }
+    return link;
+#else
+    (void)hash;
+    return find_link(key, probes);
+#endif
 }
 
 template <typename K, typename V>
-bool hash_list<K, V>::remove(K key)
+void hash_list<K, V>::link_at(node<K, V> **link, node<K, V> *new_node)
 {
-    node<K, V>* current = head;
-    node<K, V>* prev = head;
+    size += 1;
+    if (tree != NULL)
+    {
+        tree_link(new_node);
+        return;
+    }
+    new_node->next = *link;
+    *link = new_node;
+    treeify();
+}
+
+template <typename K, typename V>
+node<K, V> *hash_list<K, V>::unlink_at(node<K, V> **link)
+{
+    node<K, V> *removed = *link;
+    *link = removed->next;
+    size -= 1;
+    tree_unlink(removed);
+    removed->next = NULL;
+    return removed;
+}
 
-    if (head != NULL && (head->key == key))
+template <typename K, typename V>
+bool hash_list<K, V>::promote(node<K, V> **link, bool to_front)
+{
+    // a treeified list finds a key in the same time wherever it sits in the chain
+    if (link == &head || tree != NULL)
     {
-        node<K, V>* temp = head;
-        head = head->next;
-        delete temp;
-        // std::cout << "(REMOVE) Did remove Head: "<< "Key: " << key  << std::endl;
-        size -= 1;
-        return true;
+        return false;
     }
 
-    while (current != NULL)
+    node<K, V> **target = &head;
+    if (!to_front)
     {
-        if (current == NULL)
+        // find the link to the node before this one, which this one takes the place of
+        while (&(*target)->next != link)
         {
-            // DID NOT FIND TO REMOVE
-            //  std::cout << "(REMOVE) Did Not Find: "<< "Key: " << key  << std::endl;
-            return false;
+            target = &(*target)->next;
         }
+    }
+    link_at(target, unlink_at(link));
+    return true;
+}
 
-        if (current->key == key)
+template <typename K, typename V>
+node<K, V> *hash_list<K, V>::front() const
+{
+    return head;
+}
+
+template <typename K, typename V>
+node<K, V> **hash_list<K, V>::front_link()
+{
+    return &head;
+}
+
+template <typename K, typename V>
+template <typename Pred>
+node<K, V> *hash_list<K, V>::unlink_if(Pred pred, node<K, V> *unlinked)
+{
+    node<K, V> **link = &head;
+
+    while (*link != NULL)
+    {
+        node<K, V> *current = *link;
+        if (pred(*current))
         {
-            prev->next = current->next;
-            // free current
-            delete current;
-            // std::cout << "(REMOVE) Did Find: "<< "Key: " << key  << std::endl;
+            *link = current->next;
+            current->next = unlinked;
+            unlinked = current;
             size -= 1;
-            return true;
         }
+        else
+        {
+            link = &current->next;
+        }
+    }
 
-        prev = current;
-        current = current->next;
+    // the links moved wholesale, so index them again from scratch
+    if (tree != NULL)
+    {
+        untreeify();
+        treeify();
     }
-    // std::cout << "(REMOVE) Did Not Find: "<< "Key: " << key  << std::endl;
-    return false;
+    return unlinked;
 }
 
 template <typename K, typename V>
-size_t hash_list<K, V>::get_size() const
+void hash_list<K, V>::push_front(node<K, V> *new_node)
 {
-    // std::cout << size << std::endl;
-    return size;
+    link_at(&head, new_node);
 }
 
 template <typename K, typename V>
-hash_list<K, V>::~hash_list()
+node<K, V> *hash_list<K, V>::pop_front()
 {
-    node<K, V>* current;
+    if (head == NULL)
+    {
+        return NULL;
+    }
+    return unlink_at(&head);
+}
 
-    while (head != NULL)
+template <typename K, typename V>
+std::pmr::memory_resource *hash_list<K, V>::get_resource() const
+{
+    return resource;
+}
+
+template <typename K, typename V>
+bool hash_list<K, V>::is_treeified() const
+{
+    return tree != NULL;
+}
+
+template <typename K, typename V>
+size_t hash_list<K, V>::get_index_bytes() const
+{
+    return tree != NULL ? sizeof(tree_index) + tree->memory.bytes : 0;
+}
+
+template <typename K, typename V>
+size_t hash_list<K, V>::get_index_bytes_allocated() const
+{
+    return freed_index_bytes + (tree != NULL ? sizeof(tree_index) + tree->memory.allocated : 0);
+}
+
+template <typename K, typename V>
+template <typename Q>
+bool hash_list<K, V>::tree_search(const Q &key, size_t &block, size_t &slot) const
+{
+    // the last block whose first key isn't greater than key, or the first block
+    const std::pmr::vector<index_block *> &blocks = tree->blocks;
+    size_t low = 0;
+    size_t high = blocks.size();
+    while (high - low > 1)
     {
-        current = head;
-        // std::cout << current->key << std::endl;
-        head = head->next;
-        delete current;
+        size_t middle = low + (high - low) / 2;
+        if (key < blocks[middle]->nodes[0]->key)
+        {
+            high = middle;
+        }
+        else
+        {
+            low = middle;
+        }
     }
+    block = low;
 
-    //// std::cout << "(DESTRUCTOR)  Destruct Finished" << std::endl;
+    const index_block &found = *blocks[block];
+    slot = 0;
+    size_t count = found.count;
+    while (count > 0)
+    {
+        size_t half = count / 2;
+        if (found.nodes[slot + half]->key < key)
+        {
+            slot += half + 1;
+            count -= half + 1;
+        }
+        else
+        {
+            count = half;
+        }
+    }
+    return slot < found.count && !(key < found.nodes[slot]->key);
+}
+
+template <typename K, typename V>
+node<K, V> **hash_list<K, V>::tree_link_to(size_t block, size_t slot)
+{
+    if (slot > 0)
+    {
+        return &tree->blocks[block]->nodes[slot - 1]->next;
+    }
+    if (block > 0)
+    {
+        const index_block &previous = *tree->blocks[block - 1];
+        return &previous.nodes[previous.count - 1]->next;
+    }
+    return &head;
+}
+
+template <typename K, typename V>
+template <typename Q>
+node<K, V> **hash_list<K, V>::tree_find(const Q &key) const
+{
+    if constexpr (less_comparable<K, Q>::value && less_comparable<Q, K>::value)
+    {
+        if (tree != NULL)
+        {
+            size_t block;
+            size_t slot;
+            if (tree_search(key, block, slot))
+            {
+                return const_cast<hash_list *>(this)->tree_link_to(block, slot);
+            }
+            return &tree->last->next;
+        }
+    }
+    return NULL;
+}
+
+template <typename K, typename V>
+void hash_list<K, V>::tree_link(node<K, V> *linked)
+{
+    if constexpr (less_comparable<K, K>::value)
+    {
+        size_t block;
+        size_t slot;
+        tree_search(linked->key, block, slot);
+
+        node<K, V> **link = tree_link_to(block, slot);
+        linked->next = *link;
+        *link = linked;
+        if (linked->next == NULL)
+        {
+            tree->last = linked;
+        }
+
+        // split a full block, keeping its lower half
+        index_block *into = tree->blocks[block];
+        if (into->count == block_size)
+        {
+            index_block *upper = static_cast<index_block *>(
+                tree->memory.allocate(sizeof(index_block), alignof(index_block)));
+            upper->count = block_size / 2;
+            std::copy(into->nodes + block_size / 2, into->nodes + block_size, upper->nodes);
+            into->count = block_size / 2;
+            tree->blocks.insert(tree->blocks.begin() + block + 1, upper);
+            if (slot > block_size / 2)
+            {
+                into = upper;
+                slot -= block_size / 2;
+            }
+        }
+        std::copy_backward(into->nodes + slot, into->nodes + into->count, into->nodes + into->count + 1);
+        into->nodes[slot] = linked;
+        into->count++;
+    }
+}
+
+template <typename K, typename V>
+void hash_list<K, V>::tree_unlink(node<K, V> *removed)
+{
+    if constexpr (less_comparable<K, K>::value)
+    {
+        if (tree == NULL)
+        {
+            return;
+        }
+        if (size <= untreeify_at)
+        {
+            untreeify();
+            return;
+        }
+
+        size_t block;
+        size_t slot;
+        tree_search(removed->key, block, slot);
+        index_block *from = tree->blocks[block];
+        std::copy(from->nodes + slot + 1, from->nodes + from->count, from->nodes + slot);
+        from->count--;
+
+        // fold a sparse block into a neighbour, which also gets rid of empty ones
+        if (from->count < block_size / 4 && tree->blocks.size() > 1)
+        {
+            size_t left = block + 1 < tree->blocks.size() ? block : block - 1;
+            index_block *into = tree->blocks[left];
+            index_block *next = tree->blocks[left + 1];
+            if (into->count + next->count <= block_size)
+            {
+                std::copy(next->nodes, next->nodes + next->count, into->nodes + into->count);
+                into->count += next->count;
+                tree->memory.deallocate(next, sizeof(index_block), alignof(index_block));
+                tree->blocks.erase(tree->blocks.begin() + left + 1);
+            }
+        }
+
+        const index_block &back = *tree->blocks.back();
+        tree->last = back.nodes[back.count - 1];
+    }
+}
+
+template <typename K, typename V>
+void hash_list<K, V>::treeify()
+{
+    if constexpr (less_comparable<K, K>::value)
+    {
+        if (tree != NULL || size < treeify_at)
+        {
+            return;
+        }
+
+        std::pmr::vector<node<K, V> *> sorted(resource);
+        sorted.reserve(size);
+        for (node<K, V> *current = head; current != NULL; current = current->next)
+        {
+            sorted.push_back(current);
+        }
+        std::sort(sorted.begin(), sorted.end(),
+                  [](const node<K, V> *a, const node<K, V> *b) { return a->key < b->key; });
+
+        // relink the chain in key order and cut it into blocks three quarters full
+        tree = new (resource->allocate(sizeof(tree_index), alignof(tree_index))) tree_index(resource);
+        node<K, V> **link = &head;
+        for (size_t i = 0; i < sorted.size(); i++)
+        {
+            if (i % (block_size * 3 / 4) == 0)
+            {
+                index_block *block = static_cast<index_block *>(
+                    tree->memory.allocate(sizeof(index_block), alignof(index_block)));
+                block->count = 0;
+                tree->blocks.push_back(block);
+            }
+            index_block *block = tree->blocks.back();
+            block->nodes[block->count++] = sorted[i];
+            *link = sorted[i];
+            link = &sorted[i]->next;
+        }
+        *link = NULL;
+        tree->last = sorted.back();
+    }
+}
+
+template <typename K, typename V>
+void hash_list<K, V>::untreeify()
+{
+    if (tree != NULL)
+    {
+        freed_index_bytes = get_index_bytes_allocated();
+        tree->~tree_index();
+        resource->deallocate(tree, sizeof(tree_index), alignof(tree_index));
+        tree = NULL;
+    }
+}
+
+template <typename K, typename V>
+node_handle<K, V> hash_list<K, V>::extract(const K &key)
+{
+    size_t probes = 0;
+    node<K, V> **link = find_link(key, probes);
+    if (*link == NULL)
+    {
+        return node_handle<K, V>();
+    }
+    return node_handle<K, V>(unlink_at(link), resource);
+}
+
+template <typename K, typename V>
+bool hash_list<K, V>::insert(node_handle<K, V> &&handle)
+{
+    if (handle.empty())
+    {
+        return false;
+    }
+
+    size_t probes = 0;
+    node<K, V> **link = find_link(handle.key(), probes);
+    if (*link != NULL)
+    {
+        return false;
+    }
+
+    // only a node from an equal resource can be freed by this list later
+    node<K, V> *moved = handle.release();
+    if (!resource->is_equal(*handle.get_resource()))
+    {
+        node<K, V> *copy = _copynode(resource, *moved);
+        _delnode(handle.get_resource(), moved);
+        moved = copy;
+    }
+    link_at(link, moved);
+    return true;
+}
+
+template <typename K, typename V>
+node_handle<K, V>::node_handle()
+{
+    owned = NULL;
+    resource = NULL;
+}
+
+template <typename K, typename V>
+node_handle<K, V>::node_handle(node<K, V> *owned, std::pmr::memory_resource *resource)
+{
+    this->owned = owned;
+    this->resource = resource;
+}
+
+template <typename K, typename V>
+node_handle<K, V>::node_handle(node_handle &&other)
+{
+    owned = other.owned;
+    resource = other.resource;
+    other.owned = NULL;
+}
+
+template <typename K, typename V>
+node_handle<K, V> &node_handle<K, V>::operator=(node_handle &&other)
+{
+    if (this != &other)
+    {
+        if (owned != NULL)
+        {
+            _delnode(resource, owned);
+        }
+        owned = other.owned;
+        resource = other.resource;
+        other.owned = NULL;
+    }
+    return *this;
+}
+
+template <typename K, typename V>
+node_handle<K, V>::~node_handle()
+{
+    if (owned != NULL)
+    {
+        _delnode(resource, owned);
+    }
+}
+
+template <typename K, typename V>
+bool node_handle<K, V>::empty() const
+{
+    return owned == NULL;
+}
+
+template <typename K, typename V>
+K &node_handle<K, V>::key() const
+{
+    return owned->key;
+}
+
+template <typename K, typename V>
+V &node_handle<K, V>::value() const
+{
+    return owned->value;
+}
+
+template <typename K, typename V>
+std::pmr::memory_resource *node_handle<K, V>::get_resource() const
+{
+    return resource;
+}
+
+template <typename K, typename V>
+node<K, V> *node_handle<K, V>::release()
+{
+    node<K, V> *released = owned;
+    owned = NULL;
+    return released;
 }
 
 /** Dont modify this function for this lab. Leave it as is */
@@ -1,12 +1,173 @@
 #ifndef HASH_MAP_H
 #define HASH_MAP_H
 
+#include <memory_resource>
 #include <optional>
+#include <string>
+#include <string_view>
 #include <stddef.h>
 #include <stdlib.h>
+#include <stdint.h>
 
+#include "frozen_hash_map.h"
 #include "hash_list.h"
 
+#ifdef HASH_MAP_TTL
+#include <chrono>
+
+#include "timer_wheel.h"
+#endif
+
+#ifdef HASH_MAP_BACKGROUND_REHASH
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#endif
+
+/**
+ * Defining HASH_MAP_CACHE before including this header threads a CLOCK ring through the
+ * nodes and enables set_cache_limits and get_or_load.
+ *
+ * Defining HASH_MAP_TTL before including this header gives every node an optional expiry
+ * time and enables the expiring insert, set_expiry and remove_expired.
+ *
+ * Defining HASH_MAP_BACKGROUND_REHASH before including this header moves rehashing onto a
+ * worker thread each map starts the first time it needs to resize. Crossing a load factor
+ * limit only signals the worker, which moves the buckets into the new array one at a time
+ * while insert, get_value and remove keep working on whichever array holds the key's
+ * bucket, then publishes the new array. The map is still meant for one foreground thread.
+ * Calls that walk the whole table, such as get_capacity, copies and the bulk operations,
+ * first wait for the worker to finish.
+ *
+ * Defining HASH_MAP_STORE_HASH before including this header stores each key's full hash in
+ * its node, one size_t per node. Chain walks compare it before comparing keys, and
+ * rehashing redistributes nodes by it without hashing any key again.
+ *
+ * Defining HASH_MAP_STATS before including this header makes every hash_map keep the
+ * counters below and exposes them through hash_map::stats(). Without it the counters and
+ * stats() are compiled out entirely.
+ */
+#ifdef HASH_MAP_STATS
+#define HASH_MAP_STAT(statement) statement
+
+/** A snapshot of the counters a hash_map keeps when compiled with HASH_MAP_STATS */
+struct hash_map_stats
+{
+    /** The number of entries in probe_histogram */
+    static constexpr size_t probe_buckets = 16;
+
+    /**
+     * probe_histogram[n] is the number of lookups that compared the key against n nodes.
+     * The last entry also counts every lookup that compared against more nodes
+     */
+    size_t probe_histogram[probe_buckets] = {};
+
+    /** The total number of nodes compared against by all lookups */
+    size_t probes = 0;
+
+    /** The number of lookups that found their key */
+    size_t hits = 0;
+
+    /** The nodes compared against by lookups that found their key, included in probes */
+    size_t hit_probes = 0;
+
+    /** The number of lookups that didn't find their key */
+    size_t misses = 0;
+
+    /** The number of inserts that added a new key */
+    size_t inserts = 0;
+
+    /** The number of inserts that overwrote the value of an existing key */
+    size_t updates = 0;
+
+    /** The number of keys removed from the map */
+    size_t removes = 0;
+
+    /** The number of times the buckets were rehashed to a new capacity */
+    size_t rehashes = 0;
+
+    /** The total time spent rehashing, in nanoseconds */
+    uint64_t rehash_ns = 0;
+
+    /** The total number of bytes allocated for buckets, nodes and bucket trees over the map's lifetime */
+    size_t bytes_allocated = 0;
+
+    /** The number of bytes currently held by the map's buckets, nodes and bucket trees */
+    size_t bytes_in_use = 0;
+
+    /** The number of bytes currently held by the trees of treeified buckets, included in bytes_in_use */
+    size_t index_bytes = 0;
+
+    /** The number of entries dropped to stay within the cache limits */
+    size_t evictions = 0;
+
+    /** The number of expired entries removed by remove_expired, erase_if or retain_if */
+    size_t expirations = 0;
+
+    /** The number of lookups that moved the node they found nearer its chain's head */
+    size_t promotions = 0;
+
+    /** Records a lookup that compared against the given number of nodes */
+    void record_lookup(size_t probe_count, bool hit)
+    {
+        probe_histogram[probe_count < probe_buckets ? probe_count : probe_buckets - 1]++;
+        probes += probe_count;
+        if (hit)
+        {
+            hits++;
+            hit_probes += probe_count;
+        }
+        else
+        {
+            misses++;
+        }
+    }
+};
+#else
+#define HASH_MAP_STAT(statement)
+#endif
+
+/** How a hash_map reorders a bucket when a lookup finds a key in it */
+enum class bucket_policy
+{
+    /** Never reorder. Keys stay in the order they were inserted */
+    fixed,
+
+    /** Move the node found to the head of its chain */
+    move_to_front,
+
+    /** Swap the node found with the one before it */
+    transpose
+};
+
+/**
+ * The hash function hash_map uses for K, which is std::hash<K> unless specialized. A
+ * specialization with an is_transparent member type opts K into heterogeneous lookup:
+ * get_value, find, contains and remove then also accept any type the hash function takes
+ * that compares equal to K with ==, without converting it to K. It must hash such a key
+ * the same as the K it equals
+ */
+template <typename K>
+struct hash_map_hash : std::hash<K>
+{
+};
+
+/**
+ * Strings hash through std::basic_string_view, so a string_view or a C string can be looked
+ * up without building a string
+ */
+template <typename C, typename Traits, typename Alloc>
+struct hash_map_hash<std::basic_string<C, Traits, Alloc>>
+{
+    using is_transparent = void;
+
+    size_t operator()(std::basic_string_view<C, Traits> key) const
+    {
+        return std::hash<std::basic_string_view<C, Traits>>()(key);
+    }
+};
+
 template <typename K, typename V>
 class hash_map
 {
@@ -14,19 +175,37 @@ class hash_map
 public:
     /**
      * @brief Construct a new hash map object
+     *
+     * @param resource
+     *  Where the bucket array and nodes are allocated from. It must outlive the map. If
+     *  it is a std::pmr::monotonic_buffer_resource and K and V are trivially destructible,
+     *  destroying the map frees nothing and leaves the memory for the resource to release
+     *  in one go. Bulk operations only use several threads if resource is thread safe
      */
     hash_map(size_t capacity,
              float upper_load_factor,
-             float lower_load_factor);
+             float lower_load_factor,
+             std::pmr::memory_resource *resource = std::pmr::get_default_resource());
 
     /**
-     * @brief Construct a new hash map object
+     * @brief Construct a new hash map object. Like the std::pmr containers, the copy
+     * uses the default resource rather than other's
      *
      * @param other
      *  The map to create a copy of
      */
     hash_map(const hash_map &other);
 
+    /**
+     * @brief Construct a new hash map object
+     *
+     * @param other
+     *  The map to create a copy of
+     * @param resource
+     *  Where the copy's bucket array and nodes are allocated from
+     */
+    hash_map(const hash_map &other, std::pmr::memory_resource *resource);
+
     /**
      * @brief Constructs a new hash map from other
      *
@@ -49,6 +228,44 @@ public:
      */
     void insert(K key, V value);
 
+    /**
+     * @brief Inserts key with a value constructed in place from args if key isn't in the
+     * map. If it is, nothing is constructed and key and args aren't moved from
+     *
+     * @return
+     *  A pointer to the value now held for key, and true if it was inserted
+     */
+    template <typename... Args>
+    std::pair<V *, bool> try_emplace(const K &key, Args &&...args);
+
+    template <typename... Args>
+    std::pair<V *, bool> try_emplace(K &&key, Args &&...args);
+
+    /**
+     * @brief Inserts key with a value constructed from obj, or assigns obj to the value of
+     * key if it is already in the map. Both are forwarded, so rvalues are moved rather than
+     * copied
+     *
+     * @return
+     *  A pointer to the value now held for key, and true if it was inserted
+     */
+    template <typename M>
+    std::pair<V *, bool> insert_or_assign(const K &key, M &&obj);
+
+    template <typename M>
+    std::pair<V *, bool> insert_or_assign(K &&key, M &&obj);
+
+    /**
+     * @brief Constructs the key from key and the value from args directly in a new node,
+     * then inserts it if the key isn't already in the map. Otherwise the node is discarded
+     * and the map is unchanged
+     *
+     * @return
+     *  A pointer to the value now held for the key, and true if it was inserted
+     */
+    template <typename KArg, typename... Args>
+    std::pair<V *, bool> emplace(KArg &&key, Args &&...args);
+
     /**
      * @brief Return an optional containing the value associated with the specified key.
      * If the key isn't in the map return an empty optional.
@@ -61,6 +278,43 @@ public:
      */
     std::optional<V> get_value(K key) const;
 
+    /**
+     * @brief get_value for a key of another type, if hash_map_hash<K> is transparent. The
+     * key isn't converted to K
+     */
+    template <typename Q, typename Hash = hash_map_hash<K>, typename = typename Hash::is_transparent>
+    std::optional<V> get_value(const Q &key) const;
+
+    /**
+     * @brief Return a pointer to the value associated with the specified key without copying
+     * it, or NULL if the key isn't in the map.
+     *
+     * @param key
+     *  The key to search for
+     * @return
+     *  A pointer to the stored value. It stays valid until the key is removed or extracted,
+     *  including across rehashes, which move nodes between buckets but never reallocate them
+     */
+    V *find(const K &key);
+
+    const V *find(const K &key) const;
+
+    /** @brief find for a key of another type, if hash_map_hash<K> is transparent */
+    template <typename Q, typename Hash = hash_map_hash<K>, typename = typename Hash::is_transparent>
+    V *find(const Q &key);
+
+    template <typename Q, typename Hash = hash_map_hash<K>, typename = typename Hash::is_transparent>
+    const V *find(const Q &key) const;
+
+    /**
+     * @brief Return true if the key is in the map. Nothing is copied
+     */
+    bool contains(const K &key) const;
+
+    /** @brief contains for a key of another type, if hash_map_hash<K> is transparent */
+    template <typename Q, typename Hash = hash_map_hash<K>, typename = typename Hash::is_transparent>
+    bool contains(const Q &key) const;
+
     /**
      * @brief Remove the key and corresponding value from the map and return true.
      * If the key isn't in the map return false.
@@ -73,6 +327,35 @@ public:
      */
     bool remove(K key);
 
+    /** @brief remove for a key of another type, if hash_map_hash<K> is transparent */
+    template <typename Q, typename Hash = hash_map_hash<K>, typename = typename Hash::is_transparent>
+    bool remove(const Q &key);
+
+    /**
+     * @brief Removes key from the map without freeing its node and returns a handle that
+     * owns the node, ready to be inserted into another hash_map or hash_list. Per-node
+     * state such as an expiry travels with it
+     *
+     * @param key
+     *  The key to extract
+     * @return
+     *  A handle owning the node, or an empty handle if key isn't in the map
+     */
+    node_handle<K, V> extract(K key);
+
+    /**
+     * @brief Links the node owned by handle into the map. Nothing is allocated and the key
+     * and value aren't copied unless the node came from a resource that isn't equal to
+     * this map's
+     *
+     * @param handle
+     *  The handle to take the node from
+     * @return
+     *  True if the node was inserted, leaving handle empty. False if handle is empty or
+     *  its key is already in the map, in which case neither is changed
+     */
+    bool insert(node_handle<K, V> &&handle);
+
     /**
      * @brief Return the number of key/value pairs in the map
      */
@@ -121,6 +404,209 @@ public:
      */
     void get_bucket_sizes(size_t *buckets);
 
+    /**
+     * @brief Removes every key/value pair for which pred(key, value) returns true. Each
+     * bucket is walked once, the removed nodes are freed together at the end and the
+     * capacity is checked once. Entries that have already expired are removed as well;
+     * they aren't passed to pred and are counted as expirations rather than removes
+     *
+     * @param pred
+     *  A callable taking (const K &, const V &) and returning true for pairs to remove
+     * @return
+     *  The number of key/value pairs pred matched, not counting expired entries
+     */
+    template <typename Pred>
+    size_t erase_if(Pred pred);
+
+    /**
+     * @brief Removes every key/value pair for which pred(key, value) returns false, like
+     * erase_if with the predicate negated
+     */
+    template <typename Pred>
+    size_t retain_if(Pred pred);
+
+    /**
+     * @brief Indexes the keys in [first, first + count) by their offset from first, so
+     * finding one is a bounds check and a single array load instead of hashing and
+     * walking a chain. Keys outside the range are still found by hashing. The entries
+     * stay in their buckets, so everything else behaves the same. Only available for
+     * integral K
+     *
+     * @param first
+     *  The smallest key in the range
+     * @param count
+     *  The number of keys in the range. 0 drops the index
+     */
+    void set_dense_range(K first, size_t count);
+
+    /**
+     * @brief Choose how get_value, find and contains reorder the chain they find a key in,
+     * so that keys read often are compared first. Chains that are treeified are never
+     * reordered, since their lookups don't depend on position. Any policy but fixed makes
+     * those lookups write to the map, so they can no longer run concurrently with each other
+     *
+     * @param policy
+     *  The new policy. The default is bucket_policy::fixed
+     */
+    void set_bucket_policy(bucket_policy policy);
+
+    /**
+     * @brief Builds an immutable copy of the map whose lookups go through a minimal
+     * perfect hash function instead of buckets and chains. Entries that have expired are
+     * left out. The map itself is unchanged. Every slot is derived from the key's
+     * std::hash value, so distinct keys whose full hashes are equal can't be told apart
+     * and the map can't be frozen; keep such keys in the live map instead
+     *
+     * @param resource
+     *  Where the frozen map's arrays are allocated from
+     * @throws std::invalid_argument
+     *  If two live keys have the same std::hash value
+     */
+    frozen_hash_map<K, V> freeze(std::pmr::memory_resource *resource = std::pmr::get_default_resource()) const;
+
+    /**
+     * @brief Copies every key/value pair of other into this map. For a key that is in
+     * both maps the value becomes resolve(key, this_value, other_value). When both maps
+     * have the same capacity, matching buckets are merged in parallel across bucket ranges
+     *
+     * @param other
+     *  The map to merge from
+     * @param resolve
+     *  A callable taking (const K &, const V &, const V &) and returning the V to keep.
+     *  Every thread calls this same object, for different keys at once, so it must be safe
+     *  to call concurrently unless threads is 1
+     * @param threads
+     *  The most threads to use, or 0 to use one per hardware thread. With 1, resolve is
+     *  only ever called on the calling thread
+     */
+    template <typename Resolve>
+    void merge_from(const hash_map &other, Resolve resolve, size_t threads = 0);
+
+    /**
+     * @brief Like merge_from, but moves the nodes of other into this map instead of
+     * copying them, so no key or value is copied and nothing is allocated. other is left
+     * empty. resolve has the same thread safety requirement
+     */
+    template <typename Resolve>
+    void merge_from(hash_map &&other, Resolve resolve, size_t threads = 0);
+
+    /**
+     * @brief Removes every key that isn't also in other. The value of every remaining key
+     * becomes resolve(key, this_value, other_value). Ranges of buckets are processed in
+     * parallel
+     *
+     * @param other
+     *  The map to intersect with
+     * @param resolve
+     *  A callable taking (const K &, const V &, const V &) and returning the V to keep.
+     *  As with merge_from, it must be safe to call concurrently unless threads is 1
+     * @param threads
+     *  The most threads to use, or 0 to use one per hardware thread
+     */
+    template <typename Resolve>
+    void intersect_with(const hash_map &other, Resolve resolve, size_t threads = 0);
+
+    /**
+     * @brief Removes every key that is also in other from this map. Ranges of buckets are
+     * processed in parallel
+     *
+     * @param other
+     *  The map whose keys to remove
+     * @param threads
+     *  The most threads to use, or 0 to use one per hardware thread
+     */
+    void difference(const hash_map &other, size_t threads = 0);
+
+    /**
+     * @brief Inserts count pairs at once, as if by calling insert on each in order, so a
+     * key that appears more than once ends up with its last value. The table is sized for
+     * the input up front, the pairs are scattered by bucket with a counting sort, and then
+     * ranges of buckets are filled in parallel. Every thread writes only its own buckets,
+     * so the result is the same for any number of threads
+     *
+     * @param pairs
+     *  The key/value pairs to insert, in any order
+     * @param count
+     *  The number of pairs
+     * @param threads
+     *  The most threads to use, or 0 to use one per hardware thread
+     */
+    void bulk_insert(const std::pair<K, V> *pairs, size_t count, size_t threads = 0);
+
+#ifdef HASH_MAP_CACHE
+    /**
+     * @brief Bounds the map so it can be used as a cache. Once the map is full, inserting
+     * a new key first evicts an entry chosen by the CLOCK algorithm: the hand sweeps the
+     * entries in insertion order, giving every entry read since the hand last passed a
+     * second chance. Evicts immediately if the map is already over the new limits.
+     *
+     * @param max_entries
+     *  The maximum number of key/value pairs to hold, or 0 for no limit
+     * @param max_bytes
+     *  The maximum number of bytes the nodes may take up, or 0 for no limit. Each entry
+     *  is charged sizeof(node<K, V>)
+     */
+    void set_cache_limits(size_t max_entries, size_t max_bytes);
+
+    /**
+     * @brief Return the value associated with key. If the key isn't in the map, call
+     * loader(key) to produce the value and insert it first
+     *
+     * @param key
+     *  The key to search for
+     * @param loader
+     *  A callable taking the key and returning the value to cache for it
+     */
+    template <typename Loader>
+    V get_or_load(K key, Loader loader);
+#endif
+
+#ifdef HASH_MAP_TTL
+    /**
+     * @brief Insert the key/value pair like insert(key, value) and make it expire ttl from now
+     */
+    void insert(K key, V value, std::chrono::steady_clock::duration ttl);
+
+    /**
+     * @brief Make the entry for key expire at the specified time. An expired entry is
+     * invisible to get_value and remove right away, but keeps its memory and still counts
+     * towards get_size until remove_expired gets to it. Inserting into an expired key
+     * starts a fresh entry with no expiry.
+     *
+     * @param key
+     *  The key whose entry should expire
+     * @param when
+     *  The time to expire the entry at
+     * @return
+     *  True if the key was in the map
+     *  False otherwise
+     */
+    bool set_expiry(K key, std::chrono::steady_clock::time_point when);
+
+    /**
+     * @brief Removes entries whose expiry is at or before now, at most max_batch of them
+     * per call. Only expired entries are visited, so the cost is proportional to the
+     * number removed rather than the size of the map.
+     *
+     * @return
+     *  The number of entries removed
+     */
+    size_t remove_expired(size_t max_batch,
+                          std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now());
+#endif
+
+#ifdef HASH_MAP_STATS
+    /**
+     * @brief Returns a copy of the counters collected since the map was constructed
+     */
+    hash_map_stats stats() const;
+#endif
+
+    /**
+     * @brief Returns the resource the map allocates its buckets and nodes from
+     */
+    std::pmr::memory_resource *get_resource() const;
+
     /**
      * @brief Frees all memory associated with the map
      */
@@ -143,9 +629,181 @@ private:
      */
     void rehash(size_t new_capacity);
 
+    /**
+     * Returns the bucket that holds keys with the given hash, allowing for a rehash the
+     * worker is part way through
+     */
+    hash_list<K, V> &_chain(size_t hash) const;
+
+    /** Returns the hash of a node's key, which is stored in the node with HASH_MAP_STORE_HASH */
+    size_t _node_hash(const node<K, V> *entry) const;
+
+    /** Waits for the rehash worker, if any, to finish so the whole table can be walked */
+    void _finish_rehash() const;
+
+#ifdef HASH_MAP_BACKGROUND_REHASH
+    /**
+     * Holds the rehash mutex for its lifetime if the worker is migrating buckets when it is
+     * created. Every foreground call that looks keys up holds one, so the worker only ever
+     * moves a bucket between two calls
+     */
+    struct _rehash_lock
+    {
+        explicit _rehash_lock(const hash_map &map);
+
+        std::unique_lock<std::mutex> lock;
+    };
+
+    /** Hands new_capacity to the worker, starting it on first use */
+    void _start_rehash(size_t new_capacity);
+
+    /** The body of the worker thread */
+    void _rehash_worker();
+#else
+    struct _rehash_lock
+    {
+        explicit _rehash_lock(const hash_map &) {}
+    };
+#endif
+
+    /** Does the bookkeeping for and frees a chain of unlinked nodes, returning its length */
+    size_t _free_chain(node<K, V> *chain);
+
+    /** Rehashes as many times as it takes to bring the load factor back between the limits */
+    void _fit_capacity();
+
+    /** Allocates an array of count empty hash_lists from _resource */
+    hash_list<K, V> *_alloc_buckets(size_t count);
+
+    /** Destroys and frees an array returned by _alloc_buckets */
+    void _free_buckets(hash_list<K, V> *buckets, size_t count);
+
+    /** Returns true if the resource may be used from several threads at once */
+    static bool _thread_safe(std::pmr::memory_resource *resource);
+
+    /** Returns true if destroying the map can leave everything to the resource */
+    bool _arena_teardown() const;
+
+    /**
+     * Returns the dense index slot for key, or NULL if key is outside the dense range or
+     * isn't a K. Keys in the dense range are in their buckets too, so other types still
+     * find them by hashing
+     */
+    template <typename Q>
+    node<K, V> **_dense_slot(const Q &key) const;
+
+    /** Allocates an empty dense index for the current _dense_count */
+    void _alloc_dense();
+
+    /** Frees the dense index and drops the range */
+    void _free_dense();
+
+    /** Returns false if the node has expired and should be treated as absent */
+    static bool _live(const node<K, V> *entry);
+
+    /** What one range of buckets changed during a bulk operation */
+    struct _bulk_result
+    {
+        /** The change in the number of entries in this map */
+        ptrdiff_t size_delta = 0;
+
+        /** The change in the number of entries in the other map */
+        ptrdiff_t other_size_delta = 0;
+
+        /** The counts to add to stats() */
+        size_t inserts = 0;
+        size_t updates = 0;
+        size_t removes = 0;
+
+        /** The number of nodes allocated */
+        size_t allocations = 0;
+    };
+
+    /**
+     * Splits the buckets [0, num_buckets) into ranges of at least min_buckets, calls
+     * work(begin, end) for each on up to `threads` threads and returns the sum of the
+     * _bulk_results they return. Node bookkeeping (the CLOCK ring and timer wheel) isn't
+     * thread safe, so those builds always use one thread
+     */
+    template <typename Work>
+    _bulk_result _for_bucket_ranges(size_t num_buckets, size_t threads, Work work,
+                                    size_t min_buckets = _min_buckets_per_thread);
+
+    /**
+     * Adds one node of another map to this one, resolving a conflict with an existing key.
+     * If steal is true the node has already been unlinked from the other map and is reused
+     * or freed, otherwise it is left alone and copied if needed. their_resource is where
+     * the node came from; a stolen node is only reused if that matches _resource
+     */
+    template <typename Resolve>
+    void _merge_node(node<K, V> *theirs, bool steal, std::pmr::memory_resource *their_resource,
+                     Resolve &resolve, _bulk_result &result);
+
+    /** The fewest buckets worth handing to a thread of their own */
+    static constexpr size_t _min_buckets_per_thread = 1024;
+
+    /** The fewest bulk_insert pairs worth handing to a thread of their own */
+    static constexpr size_t _min_pairs_per_thread = 16384;
+
+    /** Does the work of get_value, find and contains: returns key's live node or NULL */
+    template <typename Q>
+    node<K, V> *_lookup(const Q &key) const;
+
+    /** Does the work of remove */
+    template <typename Q>
+    bool _remove(const Q &key);
+
+    /** Does the work of insert and returns the node now holding key */
+    node<K, V> *_insert_node(K key, V value);
+
+    /**
+     * Returns the live node for key and false, or links in the node returned by make() and
+     * returns it and true. An expired node for key is freed first. key isn't used once make
+     * has been called, so make may move from it. The capacity is left for the caller to fit
+     */
+    template <typename Make>
+    std::pair<node<K, V> *, bool> _find_or_link(const K &key, Make make);
+
+    /** Bookkeeping for a node that was just linked into one of the buckets */
+    void _on_link(node<K, V> *linked);
+
+    /** Bookkeeping for a node that is about to be unlinked from its bucket */
+    void _on_unlink(node<K, V> *unlinked);
+
+    /** Redo the bookkeeping for every node after the buckets were copied wholesale */
+    void _relink_all();
+
+#ifdef HASH_MAP_TTL
+    /** Converts a steady clock time to the millisecond ticks stored in expires_at */
+    static uint64_t _tick(std::chrono::steady_clock::time_point when);
+
+    /** Returns true if the node has an expiry at or before the current time */
+    static bool _expired(const node<K, V> *entry);
+#endif
+
+#ifdef HASH_MAP_CACHE
+    /** Evict entries until there is room for `room` more without exceeding the limit */
+    void _evict_for(size_t room);
+#endif
+
     /** A pointer to an array of hash_lists */
     hash_list<K, V> *_head;
 
+    /** Where _head and every node are allocated from. Never NULL */
+    std::pmr::memory_resource *_resource;
+
+    /** The node for each key of the dense range by offset from _dense_first, or NULL */
+    node<K, V> **_dense;
+
+    /** The smallest key of the dense range */
+    K _dense_first;
+
+    /** The number of keys in the dense range, or 0 if there is no dense index */
+    size_t _dense_count;
+
+    /** How lookups reorder the chain they find a key in */
+    bucket_policy _bucket_policy;
+
     /** The number of key/value pairs in the map */
     size_t _size;
 
@@ -158,14 +816,57 @@ private:
     /** The load factor that determines when we decrease hash map capacity */
     float _lower_load_factor;
 
-    /** Built in hashing function for type K */
-    std::hash<K> _hash;
+    /** The hashing function for type K */
+    hash_map_hash<K> _hash;
 
     /**
      * The capacities that we're using for re-sizing. This needs to be set to
      * {209, 1021, 2039}. We've defined this below for you
      */
     static size_t _capacities[];
+
+#ifdef HASH_MAP_CACHE
+    /** The next node the CLOCK hand will look at. New nodes join the ring just behind it */
+    node<K, V> *_clock_hand;
+
+    /** The most entries the map may hold, derived from set_cache_limits */
+    size_t _max_entries;
+#endif
+
+#ifdef HASH_MAP_TTL
+    /** Holds every node that has an expiry */
+    timer_wheel<K, V> _wheel;
+#endif
+
+#ifdef HASH_MAP_BACKGROUND_REHASH
+    /** The array the worker is moving buckets into, or NULL */
+    hash_list<K, V> *_new_head;
+
+    /** The capacity the worker should rehash to next, or 0 if it has nothing to do */
+    size_t _new_capacity;
+
+    /** The number of buckets of _head the worker has already moved into _new_head */
+    size_t _migrated;
+
+    /** True from when a rehash is signalled until the worker publishes the last array */
+    std::atomic<bool> _migrating;
+
+    /** Set by the destructor to make the worker exit */
+    bool _rehash_stop;
+
+    /** Guards every member above and the buckets while _migrating is true */
+    mutable std::mutex _rehash_mutex;
+
+    /** Wakes the worker when there is work, and waiters when it's done */
+    mutable std::condition_variable _rehash_signal;
+
+    std::thread _rehash_thread;
+#endif
+
+#ifdef HASH_MAP_STATS
+    /** The counters returned by stats(). Lookups update them so they must be mutable */
+    mutable hash_map_stats _stats;
+#endif
 };
 
 template <typename K, typename V>
@@ -13,30 +13,71 @@ size_t hashing_function(K key, size_t capacity)
 */
 
 template <typename K, typename V>
-hash_map<K, V>::hash_map(size_t capacity, float upper_load_factor, float lower_load_factor)
+hash_map<K, V>::hash_map(size_t capacity, float upper_load_factor, float lower_load_factor,
+                         std::pmr::memory_resource *resource)
 {
     _size = 0;
     _capacity = capacity;
-    _head = new hash_list<K, V>[_capacity];
-    for(size_t i = 0; i < _capacity; i++)
-    {
-        _head[i] = hash_list<K, V>();
-    }
-    
+    _upper_load_factor = upper_load_factor;
+    _lower_load_factor = lower_load_factor;
+    _bucket_policy = bucket_policy::fixed;
+    _resource = resource;
+    _head = _alloc_buckets(_capacity);
+    _dense = NULL;
+    _dense_first = K();
+    _dense_count = 0;
+#ifdef HASH_MAP_BACKGROUND_REHASH
+    _new_head = NULL;
+    _new_capacity = 0;
+    _migrated = 0;
+    _migrating = false;
+    _rehash_stop = false;
+#endif
+#ifdef HASH_MAP_CACHE
+    _clock_hand = NULL;
+    _max_entries = SIZE_MAX;
+#endif
+    HASH_MAP_STAT(_stats.bytes_allocated += _capacity * sizeof(hash_list<K, V>));
+}
+
+template <typename K, typename V>
+hash_map<K, V>::hash_map(const hash_map &other) : hash_map(other, std::pmr::get_default_resource())
+{
 }
 
 template <typename K, typename V>
-hash_map<K, V>::hash_map(const hash_map &other)
+hash_map<K, V>::hash_map(const hash_map &other, std::pmr::memory_resource *resource)
 {
     // create empty hashmap
+    other._finish_rehash();
     _size = 0;
     _capacity = other._capacity;
-    _head = new hash_list<K,V>[_capacity];
+    _upper_load_factor = other._upper_load_factor;
+    _lower_load_factor = other._lower_load_factor;
+    _bucket_policy = other._bucket_policy;
+    _resource = resource;
+#ifdef HASH_MAP_BACKGROUND_REHASH
+    _new_head = NULL;
+    _new_capacity = 0;
+    _migrated = 0;
+    _migrating = false;
+    _rehash_stop = false;
+#endif
+    _head = _alloc_buckets(_capacity);
     for(size_t i = 0; i < _capacity; i++)
     {
         _head[i] = other._head[i];
     }
     _size = other._size;
+    _dense_first = other._dense_first;
+    _dense_count = other._dense_count;
+    _alloc_dense();
+#ifdef HASH_MAP_CACHE
+    _max_entries = other._max_entries;
+#endif
+    _relink_all();
+    HASH_MAP_STAT(_stats.bytes_allocated += _capacity * sizeof(hash_list<K, V>) +
+                                            _size * sizeof(node<K, V>));
     return;
 }
 
@@ -46,39 +87,410 @@ hash_map<K, V> &hash_map<K, V>::operator=(const hash_map<K, V> &other)
     if(this == &other){
         return *this;
     }
-    _capacity = other._capacity;
+    _finish_rehash();
+    other._finish_rehash();
+    // the bucket arrays only line up if both maps have the same capacity
+    if(_capacity != other._capacity){
+        _free_buckets(_head, _capacity);
+        _capacity = other._capacity;
+        _head = _alloc_buckets(_capacity);
+        HASH_MAP_STAT(_stats.bytes_allocated += _capacity * sizeof(hash_list<K, V>));
+    }
     _size = other._size;
+    _upper_load_factor = other._upper_load_factor;
+    _lower_load_factor = other._lower_load_factor;
+    _bucket_policy = other._bucket_policy;
     for(size_t i = 0; i < _capacity; i++)
     {
         _head[i] = other._head[i];
     }
+    _free_dense();
+    _dense_first = other._dense_first;
+    _dense_count = other._dense_count;
+    _alloc_dense();
+#ifdef HASH_MAP_CACHE
+    _max_entries = other._max_entries;
+#endif
+    _relink_all();
+    HASH_MAP_STAT(_stats.bytes_allocated += _size * sizeof(node<K, V>));
     return *this;
 }
 
 template <typename K, typename V>
 void hash_map<K, V>::insert(K key, V value)
 {
-    size_t i = _hash(key) % (_capacity); // get index
-    _size -= _head[i].get_size();
-    _head[i].insert(key, value);
-    _size += _head[i].get_size();
+    _rehash_lock guard(*this);
+    _insert_node(key, value);
+}
+
+template <typename K, typename V>
+node<K, V> *hash_map<K, V>::_insert_node(K key, V value)
+{
+    std::pair<node<K, V> *, bool> found = _find_or_link(key, [&]() {
+        HASH_MAP_STAT(_stats.bytes_allocated += sizeof(node<K, V>));
+        return _emplacenode<K, V>(_resource, std::move(key), std::move(value));
+    });
+
+    // overwrite the value of an existing key
+    if (!found.second)
+    {
+        found.first->value = std::move(value);
+        HASH_MAP_STAT(_stats.updates++);
+    }
+
+    // rehashing relinks nodes rather than moving them, so the node stays valid
+    _fit_capacity();
+    return found.first;
+}
+
+template <typename K, typename V>
+template <typename Make>
+std::pair<node<K, V> *, bool> hash_map<K, V>::_find_or_link(const K &key, Make make)
+{
+    size_t hash = _hash(key);
+    hash_list<K, V> &chain = _chain(hash);
+    size_t probes = 0;
+
+    // a key in the dense range is found without walking the chain, and a new one can go at
+    // the front of it
+    node<K, V> **slot = _dense_slot(key);
+    node<K, V> **link = slot != NULL ? chain.front_link() : chain.find_link(key, hash, probes);
+    node<K, V> *existing = slot != NULL ? *slot : *link;
+
+    if (existing != NULL && _live(existing))
+    {
+        return {existing, false};
+    }
+
+    // an expired entry is gone as far as callers can tell, so it makes way for a fresh one
+    if (existing != NULL)
+    {
+        if (slot != NULL)
+        {
+            link = chain.find_link(key, hash, probes);
+        }
+        _on_unlink(existing);
+        _delnode(_resource, chain.unlink_at(link));
+        _size--;
+    }
+
+#ifdef HASH_MAP_CACHE
+    // evicting may unlink the node our link points into, so look it up again
+    if (_size >= _max_entries)
+    {
+        _evict_for(1);
+        link = slot != NULL ? chain.front_link() : chain.find_link(key, hash, probes);
+    }
+#endif
+
+    node<K, V> *new_node = make();
+#ifdef HASH_MAP_STORE_HASH
+    new_node->hash = hash;
+#endif
+    chain.link_at(link, new_node);
+    _on_link(new_node);
+    _size++;
+    HASH_MAP_STAT(_stats.inserts++);
+    return {new_node, true};
+}
+
+template <typename K, typename V>
+template <typename... Args>
+std::pair<V *, bool> hash_map<K, V>::try_emplace(const K &key, Args &&...args)
+{
+    _rehash_lock guard(*this);
+    std::pair<node<K, V> *, bool> found = _find_or_link(key, [&]() {
+        HASH_MAP_STAT(_stats.bytes_allocated += sizeof(node<K, V>));
+        return _emplacenode<K, V>(_resource, key, std::forward<Args>(args)...);
+    });
+    _fit_capacity();
+    return {&found.first->value, found.second};
+}
+
+template <typename K, typename V>
+template <typename... Args>
+std::pair<V *, bool> hash_map<K, V>::try_emplace(K &&key, Args &&...args)
+{
+    _rehash_lock guard(*this);
+    std::pair<node<K, V> *, bool> found = _find_or_link(key, [&]() {
+        HASH_MAP_STAT(_stats.bytes_allocated += sizeof(node<K, V>));
+        return _emplacenode<K, V>(_resource, std::move(key), std::forward<Args>(args)...);
+    });
+    _fit_capacity();
+    return {&found.first->value, found.second};
+}
+
+template <typename K, typename V>
+template <typename M>
+std::pair<V *, bool> hash_map<K, V>::insert_or_assign(const K &key, M &&obj)
+{
+    _rehash_lock guard(*this);
+    std::pair<node<K, V> *, bool> found = _find_or_link(key, [&]() {
+        HASH_MAP_STAT(_stats.bytes_allocated += sizeof(node<K, V>));
+        return _emplacenode<K, V>(_resource, key, std::forward<M>(obj));
+    });
+    if (!found.second)
+    {
+        found.first->value = std::forward<M>(obj);
+        HASH_MAP_STAT(_stats.updates++);
+    }
+    _fit_capacity();
+    return {&found.first->value, found.second};
+}
+
+template <typename K, typename V>
+template <typename M>
+std::pair<V *, bool> hash_map<K, V>::insert_or_assign(K &&key, M &&obj)
+{
+    _rehash_lock guard(*this);
+    std::pair<node<K, V> *, bool> found = _find_or_link(key, [&]() {
+        HASH_MAP_STAT(_stats.bytes_allocated += sizeof(node<K, V>));
+        return _emplacenode<K, V>(_resource, std::move(key), std::forward<M>(obj));
+    });
+    if (!found.second)
+    {
+        found.first->value = std::forward<M>(obj);
+        HASH_MAP_STAT(_stats.updates++);
+    }
+    _fit_capacity();
+    return {&found.first->value, found.second};
+}
+
+template <typename K, typename V>
+template <typename KArg, typename... Args>
+std::pair<V *, bool> hash_map<K, V>::emplace(KArg &&key, Args &&...args)
+{
+    _rehash_lock guard(*this);
+    node<K, V> *built = _emplacenode<K, V>(_resource, std::forward<KArg>(key), std::forward<Args>(args)...);
+    std::pair<node<K, V> *, bool> found = _find_or_link(built->key, [&]() { return built; });
+    if (!found.second)
+    {
+        _delnode(_resource, built);
+        return {&found.first->value, false};
+    }
+    HASH_MAP_STAT(_stats.bytes_allocated += sizeof(node<K, V>));
+    _fit_capacity();
+    return {&found.first->value, true};
 }
 
 template <typename K, typename V>
 std::optional<V> hash_map<K, V>::get_value(K key) const
 {
-    size_t i = _hash(key) % (_capacity); // get index
-    return _head[i].get_value(key);
+    node<K, V> *found = _lookup(key);
+    if (found == NULL)
+    {
+        return {};
+    }
+    return found->value;
+}
+
+template <typename K, typename V>
+template <typename Q, typename Hash, typename>
+std::optional<V> hash_map<K, V>::get_value(const Q &key) const
+{
+    node<K, V> *found = _lookup(key);
+    if (found == NULL)
+    {
+        return {};
+    }
+    return found->value;
+}
+
+template <typename K, typename V>
+V *hash_map<K, V>::find(const K &key)
+{
+    node<K, V> *found = _lookup(key);
+    return found == NULL ? NULL : &found->value;
+}
+
+template <typename K, typename V>
+const V *hash_map<K, V>::find(const K &key) const
+{
+    node<K, V> *found = _lookup(key);
+    return found == NULL ? NULL : &found->value;
+}
+
+template <typename K, typename V>
+template <typename Q, typename Hash, typename>
+V *hash_map<K, V>::find(const Q &key)
+{
+    node<K, V> *found = _lookup(key);
+    return found == NULL ? NULL : &found->value;
+}
+
+template <typename K, typename V>
+template <typename Q, typename Hash, typename>
+const V *hash_map<K, V>::find(const Q &key) const
+{
+    node<K, V> *found = _lookup(key);
+    return found == NULL ? NULL : &found->value;
+}
+
+template <typename K, typename V>
+bool hash_map<K, V>::contains(const K &key) const
+{
+    return _lookup(key) != NULL;
+}
+
+template <typename K, typename V>
+template <typename Q, typename Hash, typename>
+bool hash_map<K, V>::contains(const Q &key) const
+{
+    return _lookup(key) != NULL;
+}
+
+template <typename K, typename V>
+template <typename Q>
+node<K, V> *hash_map<K, V>::_lookup(const Q &key) const
+{
+    _rehash_lock guard(*this);
+    size_t probes = 0;
+    node<K, V> *found;
+    if (node<K, V> **slot = _dense_slot(key))
+    {
+        found = *slot;
+        probes = found != NULL;
+    }
+    else if (_bucket_policy == bucket_policy::fixed)
+    {
+        size_t hash = _hash(key);
+        found = _chain(hash).find_node(key, hash, probes);
+    }
+    else
+    {
+        size_t hash = _hash(key);
+        hash_list<K, V> &chain = _chain(hash);
+        node<K, V> **link = chain.find_link(key, hash, probes);
+        found = *link;
+        if (found != NULL && _live(found) &&
+            chain.promote(link, _bucket_policy == bucket_policy::move_to_front))
+        {
+            HASH_MAP_STAT(_stats.promotions++);
+        }
+    }
+#ifdef HASH_MAP_TTL
+    if (found != NULL && _expired(found))
+    {
+        found = NULL;
+    }
+#endif
+    HASH_MAP_STAT(_stats.record_lookup(probes, found != NULL));
+
+#ifdef HASH_MAP_CACHE
+    if (found != NULL)
+    {
+        found->referenced = true;
+    }
+#endif
+    return found;
 }
 
 template <typename K, typename V>
 bool hash_map<K, V>::remove(K key)
 {
-    size_t i = _hash(key) % (_capacity);
-    _size -= _head[i].get_size();
-    bool isSuccessful = _head[i].remove(key);
-    _size += _head[i].get_size();
-    return isSuccessful;
+    return _remove(key);
+}
+
+template <typename K, typename V>
+template <typename Q, typename Hash, typename>
+bool hash_map<K, V>::remove(const Q &key)
+{
+    return _remove(key);
+}
+
+template <typename K, typename V>
+template <typename Q>
+bool hash_map<K, V>::_remove(const Q &key)
+{
+    _rehash_lock guard(*this);
+    node<K, V> **slot = _dense_slot(key);
+    if (slot != NULL && *slot == NULL)
+    {
+        return false;
+    }
+
+    size_t hash = _hash(key);
+    hash_list<K, V> &chain = _chain(hash);
+    size_t probes = 0;
+    node<K, V> **link = chain.find_link(key, hash, probes);
+
+    if (*link == NULL)
+    {
+        return false;
+    }
+
+    // an expired entry is still unlinked here, but it doesn't count as removing anything
+    bool was_live = true;
+#ifdef HASH_MAP_TTL
+    was_live = !_expired(*link);
+#endif
+
+    _on_unlink(*link);
+    _delnode(_resource, chain.unlink_at(link));
+    _size--;
+    if (was_live)
+    {
+        HASH_MAP_STAT(_stats.removes++);
+    }
+
+    _fit_capacity();
+    return was_live;
+}
+
+template <typename K, typename V>
+node_handle<K, V> hash_map<K, V>::extract(K key)
+{
+    _rehash_lock guard(*this);
+    size_t hash = _hash(key);
+    hash_list<K, V> &chain = _chain(hash);
+    size_t probes = 0;
+    node<K, V> **link = chain.find_link(key, hash, probes);
+
+    if (*link == NULL)
+    {
+        return node_handle<K, V>();
+    }
+
+    node<K, V> *extracted = *link;
+    _on_unlink(extracted);
+    chain.unlink_at(link);
+    _size--;
+    _fit_capacity();
+
+    // an expired entry is gone as far as callers can tell, so it's freed rather than handed out
+    node_handle<K, V> handle(extracted, _resource);
+    if (!_live(extracted))
+    {
+        return node_handle<K, V>();
+    }
+    HASH_MAP_STAT(_stats.removes++);
+    return handle;
+}
+
+template <typename K, typename V>
+bool hash_map<K, V>::insert(node_handle<K, V> &&handle)
+{
+    _rehash_lock guard(*this);
+    if (handle.empty())
+    {
+        return false;
+    }
+
+    std::pair<node<K, V> *, bool> found = _find_or_link(handle.key(), [&]() {
+        node<K, V> *inserted = handle.release();
+
+        // a node from an unequal resource couldn't be freed by this map later, so it's copied
+        if (!_resource->is_equal(*handle.get_resource()))
+        {
+            node<K, V> *copy = _copynode(_resource, *inserted);
+            _delnode(handle.get_resource(), inserted);
+            inserted = copy;
+            HASH_MAP_STAT(_stats.bytes_allocated += sizeof(node<K, V>));
+        }
+        return inserted;
+    });
+    _fit_capacity();
+    return found.second;
 }
 
 template <typename K, typename V>
@@ -90,12 +502,14 @@ size_t hash_map<K, V>::get_size() const
 template <typename K, typename V>
 size_t hash_map<K, V>::get_capacity() const
 {
+    _finish_rehash();
     return _capacity;
 }
 
 template <typename K, typename V>
 void hash_map<K, V>::get_all_keys(K *keys)
 {   int count = 0;
+    _finish_rehash();
     for (size_t i = 0; i < _capacity; i++)
     {   
         _head[i].reset_iter();
@@ -112,27 +526,16 @@ void hash_map<K, V>::get_all_keys(K *keys)
 
 template <typename K, typename V>
 void hash_map<K,V>::get_all_sorted_keys(K *keys){
-    int change = 0;
-    K temp = 0;
-    for(size_t i = 0; i<_capacity - 1; i++){
-        for(size_t j = 0; j < _capacity - 1 - i; j++){
-            if(keys[j] > keys[j+1]){
-                temp = keys[j];
-                keys[j] = keys[j+1];
-                keys[j+1] = temp;
-                change = 1;
-            }
-            if(change){
-                break;
-            }
-        }
-    }   
+    // keys only has room for _size entries, so sort exactly the keys we copied
+    get_all_keys(keys);
+    std::sort(keys, keys + _size);
 }
 
 
 template <typename K, typename V>
 void hash_map<K, V>::get_bucket_sizes(size_t * buckets)
 {
+    _finish_rehash();
     for (size_t i = 0; i < _capacity; i++)
     {
         buckets[i] = _head[i].get_size();
@@ -142,28 +545,1032 @@ void hash_map<K, V>::get_bucket_sizes(size_t * buckets)
 template <typename K, typename V>
 hash_map<K, V>::~hash_map()
 {
-    delete[] _head ;
+#ifdef HASH_MAP_BACKGROUND_REHASH
+    {
+        std::lock_guard<std::mutex> lock(_rehash_mutex);
+        _rehash_stop = true;
+    }
+    _rehash_signal.notify_all();
+    if (_rehash_thread.joinable())
+    {
+        _rehash_thread.join();
+    }
+#endif
+    if (_arena_teardown())
+    {
+        return;
+    }
+    _free_dense();
+    _free_buckets(_head, _capacity);
+}
+
+template <typename K, typename V>
+std::pmr::memory_resource *hash_map<K, V>::get_resource() const
+{
+    return _resource;
+}
+
+#ifdef HASH_MAP_STATS
+template <typename K, typename V>
+hash_map_stats hash_map<K, V>::stats() const
+{
+    _finish_rehash();
+    hash_map_stats snapshot = _stats;
+    for (size_t i = 0; i < _capacity; i++)
+    {
+        snapshot.index_bytes += _head[i].get_index_bytes();
+        snapshot.bytes_allocated += _head[i].get_index_bytes_allocated();
+    }
+    snapshot.bytes_in_use = _capacity * sizeof(hash_list<K, V>) + _size * sizeof(node<K, V>) +
+                            _dense_count * sizeof(node<K, V> *) + snapshot.index_bytes;
+    return snapshot;
+}
+#endif
+
+template <typename K, typename V>
+std::optional<size_t> hash_map<K, V>::need_to_rehash()
+{
+    size_t num_capacities = sizeof(_capacities) / sizeof(_capacities[0]);
+
+    // expand to the next larger capacity
+    if (_size > _upper_load_factor * _capacity)
+    {
+        for (size_t i = 0; i < num_capacities; i++)
+        {
+            if (_capacities[i] > _capacity)
+            {
+                return _capacities[i];
+            }
+        }
+    }
+    // shrink to the next smaller capacity, unless that would immediately need to expand again
+    else if (_size < _lower_load_factor * _capacity)
+    {
+        for (size_t i = num_capacities; i > 0; i--)
+        {
+            if (_capacities[i - 1] < _capacity)
+            {
+                if (_size > _upper_load_factor * _capacities[i - 1])
+                {
+                    return {};
+                }
+                return _capacities[i - 1];
+            }
+        }
+    }
+    return {};
+}
+
+template <typename K, typename V>
+void hash_map<K, V>::rehash(size_t new_capacity)
+{
+    HASH_MAP_STAT(auto start = std::chrono::steady_clock::now());
+
+    hash_list<K, V> *old_head = _head;
+    size_t old_capacity = _capacity;
+
+    _capacity = new_capacity;
+    _head = _alloc_buckets(_capacity);
+
+    // relink the existing nodes instead of copying them
+    for (size_t i = 0; i < old_capacity; i++)
+    {
+        while (node<K, V> *current = old_head[i].pop_front())
+        {
+            _head[_node_hash(current) % _capacity].push_front(current);
+        }
+    }
+    _free_buckets(old_head, old_capacity);
+
+    HASH_MAP_STAT(_stats.rehashes++);
+    HASH_MAP_STAT(_stats.bytes_allocated += _capacity * sizeof(hash_list<K, V>));
+    HASH_MAP_STAT(_stats.rehash_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                          std::chrono::steady_clock::now() - start)
+                                          .count());
+}
+
+template <typename K, typename V>
+hash_list<K, V> &hash_map<K, V>::_chain(size_t hash) const
+{
+#ifdef HASH_MAP_BACKGROUND_REHASH
+    // the worker moves buckets in index order, so the ones before _migrated are in the new array
+    if (_new_head != NULL && hash % _capacity < _migrated)
+    {
+        return _new_head[hash % _new_capacity];
+    }
+#endif
+    return _head[hash % _capacity];
+}
+
+template <typename K, typename V>
+size_t hash_map<K, V>::_node_hash(const node<K, V> *entry) const
+{
+#ifdef HASH_MAP_STORE_HASH
+    return entry->hash;
+#else
+    return _hash(entry->key);
+#endif
+}
+
+template <typename K, typename V>
+void hash_map<K, V>::_finish_rehash() const
+{
+#ifdef HASH_MAP_BACKGROUND_REHASH
+    if (!_migrating.load(std::memory_order_acquire))
+    {
+        return;
+    }
+    std::unique_lock<std::mutex> lock(_rehash_mutex);
+    _rehash_signal.wait(lock, [this]() { return !_migrating.load(std::memory_order_relaxed); });
+#endif
+}
+
+#ifdef HASH_MAP_BACKGROUND_REHASH
+template <typename K, typename V>
+hash_map<K, V>::_rehash_lock::_rehash_lock(const hash_map &map)
+{
+    if (map._migrating.load(std::memory_order_acquire))
+    {
+        lock = std::unique_lock<std::mutex>(map._rehash_mutex);
+
+        // the worker may have published while we waited, in which case it's idle again
+        if (!map._migrating.load(std::memory_order_relaxed))
+        {
+            lock.unlock();
+        }
+    }
+}
+
+template <typename K, typename V>
+void hash_map<K, V>::_start_rehash(size_t new_capacity)
+{
+    {
+        std::lock_guard<std::mutex> lock(_rehash_mutex);
+        _new_capacity = new_capacity;
+        _migrating.store(true, std::memory_order_relaxed);
+        if (!_rehash_thread.joinable())
+        {
+            _rehash_thread = std::thread(&hash_map::_rehash_worker, this);
+        }
+    }
+    _rehash_signal.notify_all();
 }
 
- std::optional<size_t> hash_map::need_to_rehash(){
-        //expand
-        if(_size > _upper_load_factor * _capacity){
-            _capacity++;
-            rehash(_capacity);
+template <typename K, typename V>
+void hash_map<K, V>::_rehash_worker()
+{
+    std::unique_lock<std::mutex> lock(_rehash_mutex);
+    while (true)
+    {
+        _rehash_signal.wait(lock, [this]() { return _new_capacity != 0 || _rehash_stop; });
+        if (_new_capacity == 0)
+        {
+            return;
+        }
+
+        HASH_MAP_STAT(auto start = std::chrono::steady_clock::now());
+        _migrated = 0;
+        _new_head = _alloc_buckets(_new_capacity);
+
+        while (_migrated < _capacity)
+        {
+            while (node<K, V> *current = _head[_migrated].pop_front())
+            {
+                _new_head[_node_hash(current) % _new_capacity].push_front(current);
+            }
+            _migrated++;
+
+            // let a waiting foreground call in between buckets
+            lock.unlock();
+            std::this_thread::yield();
+            lock.lock();
         }
-        //decrease
-        if(_size < _upper_load_factor * capacity){
-            _capacity--;
-            rehash(_capacity);
+
+        _free_buckets(_head, _capacity);
+        _head = _new_head;
+        _capacity = _new_capacity;
+        _new_head = NULL;
+        _migrated = 0;
+        HASH_MAP_STAT(_stats.rehashes++);
+        HASH_MAP_STAT(_stats.bytes_allocated += _capacity * sizeof(hash_list<K, V>));
+        HASH_MAP_STAT(_stats.rehash_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                              std::chrono::steady_clock::now() - start)
+                                              .count());
+
+        // the foreground is locked out until _migrating is cleared, so _size is stable here
+        // and a second step (209 to 1021 to 2039) follows without handing back
+        _new_capacity = need_to_rehash().value_or(0);
+        if (_new_capacity == 0)
+        {
+            _migrating.store(false, std::memory_order_release);
+            _rehash_signal.notify_all();
         }
- }
+    }
+}
+#endif
+
+template <typename K, typename V>
+size_t hash_map<K, V>::_free_chain(node<K, V> *chain)
+{
+    size_t freed = 0;
+    while (chain != NULL)
+    {
+        node<K, V> *next = chain->next;
+        _on_unlink(chain);
+        _delnode(_resource, chain);
+        chain = next;
+        freed++;
+    }
+    return freed;
+}
+
+template <typename K, typename V>
+hash_list<K, V> *hash_map<K, V>::_alloc_buckets(size_t count)
+{
+    void *memory = _resource->allocate(count * sizeof(hash_list<K, V>), alignof(hash_list<K, V>));
+    hash_list<K, V> *buckets = static_cast<hash_list<K, V> *>(memory);
+    for (size_t i = 0; i < count; i++)
+    {
+        new (&buckets[i]) hash_list<K, V>(_resource);
+    }
+    return buckets;
+}
+
+template <typename K, typename V>
+void hash_map<K, V>::_free_buckets(hash_list<K, V> *buckets, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        HASH_MAP_STAT(_stats.bytes_allocated += buckets[i].get_index_bytes_allocated());
+        buckets[i].~hash_list();
+    }
+    _resource->deallocate(buckets, count * sizeof(hash_list<K, V>), alignof(hash_list<K, V>));
+}
+
+template <typename K, typename V>
+bool hash_map<K, V>::_thread_safe(std::pmr::memory_resource *resource)
+{
+    return resource == std::pmr::new_delete_resource() ||
+           dynamic_cast<std::pmr::synchronized_pool_resource *>(resource) != NULL;
+}
 
 template <typename K, typename V>
- void hash_map::rehash(size_t new_capacity){
-    //size_t = _capacity;
-    //_capacity *= 2;
-    //_upper_load_factor = _size * _capacity;
-  // hash_list<K,V> *temp = _head;
-    //_head = new hash_list<K,V>;
-    hash_map(new_capacity,upper_load_factor, lower_load_factor);
- }
\ No newline at end of file
+bool hash_map<K, V>::_arena_teardown() const
+{
+    // a monotonic resource ignores deallocate, so walking the nodes would only run no-op
+    // destructors and frees
+    return std::is_trivially_destructible<K>::value && std::is_trivially_destructible<V>::value &&
+           dynamic_cast<std::pmr::monotonic_buffer_resource *>(_resource) != NULL;
+}
+
+template <typename K, typename V>
+frozen_hash_map<K, V> hash_map<K, V>::freeze(std::pmr::memory_resource *resource) const
+{
+    _finish_rehash();
+    std::vector<std::pair<K, V>> pairs;
+    pairs.reserve(_size);
+    for (size_t i = 0; i < _capacity; i++)
+    {
+        for (node<K, V> *current = _head[i].front(); current != NULL; current = current->next)
+        {
+            if (_live(current))
+            {
+                pairs.emplace_back(current->key, current->value);
+            }
+        }
+    }
+    return frozen_hash_map<K, V>(pairs, resource);
+}
+
+template <typename K, typename V>
+template <typename Q>
+node<K, V> **hash_map<K, V>::_dense_slot(const Q &key) const
+{
+    if constexpr (std::is_integral<K>::value && std::is_same<Q, K>::value)
+    {
+        // keys below the range wrap around to huge offsets, so one compare covers both ends
+        size_t offset = size_t(key) - size_t(_dense_first);
+        if (offset < _dense_count)
+        {
+            return &_dense[offset];
+        }
+    }
+    return NULL;
+}
+
+template <typename K, typename V>
+void hash_map<K, V>::_alloc_dense()
+{
+    if (_dense_count == 0)
+    {
+        _dense = NULL;
+        return;
+    }
+    void *memory = _resource->allocate(_dense_count * sizeof(node<K, V> *), alignof(node<K, V> *));
+    _dense = static_cast<node<K, V> **>(memory);
+    std::fill(_dense, _dense + _dense_count, (node<K, V> *)NULL);
+    HASH_MAP_STAT(_stats.bytes_allocated += _dense_count * sizeof(node<K, V> *));
+}
+
+template <typename K, typename V>
+void hash_map<K, V>::_free_dense()
+{
+    if (_dense != NULL)
+    {
+        _resource->deallocate(_dense, _dense_count * sizeof(node<K, V> *), alignof(node<K, V> *));
+    }
+    _dense = NULL;
+    _dense_count = 0;
+}
+
+template <typename K, typename V>
+void hash_map<K, V>::set_dense_range(K first, size_t count)
+{
+    static_assert(std::is_integral<K>::value, "set_dense_range needs an integral key type");
+    _finish_rehash();
+
+    _free_dense();
+    _dense_first = first;
+    _dense_count = count;
+    _alloc_dense();
+
+    for (size_t i = 0; i < _capacity && _dense_count != 0; i++)
+    {
+        for (node<K, V> *current = _head[i].front(); current != NULL; current = current->next)
+        {
+            if (node<K, V> **slot = _dense_slot(current->key))
+            {
+                *slot = current;
+            }
+        }
+    }
+}
+
+template <typename K, typename V>
+void hash_map<K, V>::set_bucket_policy(bucket_policy policy)
+{
+    _bucket_policy = policy;
+}
+
+template <typename K, typename V>
+void hash_map<K, V>::_fit_capacity()
+{
+#ifdef HASH_MAP_BACKGROUND_REHASH
+    // a running worker checks the load factor again itself before it finishes
+    if (_migrating.load(std::memory_order_relaxed))
+    {
+        return;
+    }
+    if (std::optional<size_t> new_capacity = need_to_rehash())
+    {
+        _start_rehash(new_capacity.value());
+    }
+#else
+    while (std::optional<size_t> new_capacity = need_to_rehash())
+    {
+        rehash(new_capacity.value());
+    }
+#endif
+}
+
+template <typename K, typename V>
+bool hash_map<K, V>::_live(const node<K, V> *entry)
+{
+#ifdef HASH_MAP_TTL
+    return !_expired(entry);
+#else
+    (void)entry;
+    return true;
+#endif
+}
+
+template <typename K, typename V>
+void hash_map<K, V>::_on_link(node<K, V> *linked)
+{
+    if (node<K, V> **slot = _dense_slot(linked->key))
+    {
+        *slot = linked;
+    }
+#ifdef HASH_MAP_CACHE
+    // join the ring just behind the hand so the node is the last one the hand reaches
+    linked->referenced = false;
+    if (_clock_hand == NULL)
+    {
+        linked->clock_prev = linked;
+        linked->clock_next = linked;
+        _clock_hand = linked;
+    }
+    else
+    {
+        linked->clock_next = _clock_hand;
+        linked->clock_prev = _clock_hand->clock_prev;
+        _clock_hand->clock_prev->clock_next = linked;
+        _clock_hand->clock_prev = linked;
+    }
+#endif
+#ifdef HASH_MAP_TTL
+    // new nodes have no expiry, but nodes copied from another map may
+    linked->timer_next = NULL;
+    linked->timer_pprev = NULL;
+    if (linked->expires_at != 0)
+    {
+        _wheel.schedule(linked, _tick(std::chrono::steady_clock::now()));
+    }
+#endif
+}
+
+template <typename K, typename V>
+void hash_map<K, V>::_on_unlink(node<K, V> *unlinked)
+{
+    if (node<K, V> **slot = _dense_slot(unlinked->key))
+    {
+        *slot = NULL;
+    }
+#ifdef HASH_MAP_CACHE
+    if (unlinked->clock_next == unlinked)
+    {
+        _clock_hand = NULL;
+    }
+    else
+    {
+        if (_clock_hand == unlinked)
+        {
+            _clock_hand = unlinked->clock_next;
+        }
+        unlinked->clock_prev->clock_next = unlinked->clock_next;
+        unlinked->clock_next->clock_prev = unlinked->clock_prev;
+    }
+#endif
+#ifdef HASH_MAP_TTL
+    _wheel.cancel(unlinked);
+#endif
+}
+
+template <typename K, typename V>
+void hash_map<K, V>::_relink_all()
+{
+    std::fill(_dense, _dense + _dense_count, (node<K, V> *)NULL);
+#if !defined(HASH_MAP_CACHE) && !defined(HASH_MAP_TTL)
+    if (_dense_count == 0)
+    {
+        return;
+    }
+#endif
+#ifdef HASH_MAP_CACHE
+    // the copied nodes carry no recency, so the ring simply follows bucket order
+    _clock_hand = NULL;
+#endif
+#ifdef HASH_MAP_TTL
+    _wheel.clear();
+#endif
+    for (size_t i = 0; i < _capacity; i++)
+    {
+        for (node<K, V> *current = _head[i].front(); current != NULL; current = current->next)
+        {
+            _on_link(current);
+        }
+    }
+}
+
+template <typename K, typename V>
+template <typename Pred>
+size_t hash_map<K, V>::erase_if(Pred pred)
+{
+    _finish_rehash();
+    node<K, V> *unlinked = NULL;
+    size_t expired = 0;
+    auto matches = [&pred, &expired](const node<K, V> &entry) {
+        if (!_live(&entry))
+        {
+            expired++;
+            return true;
+        }
+        return static_cast<bool>(pred(entry.key, entry.value));
+    };
+
+    for (size_t i = 0; i < _capacity; i++)
+    {
+        unlinked = _head[i].unlink_if(matches, unlinked);
+    }
+
+    size_t freed = _free_chain(unlinked);
+    _size -= freed;
+
+    // expired entries are swept along with the matches but aren't reported as removed
+    size_t removed = freed - expired;
+    HASH_MAP_STAT(_stats.removes += removed);
+    HASH_MAP_STAT(_stats.expirations += expired);
+    _fit_capacity();
+    return removed;
+}
+
+template <typename K, typename V>
+template <typename Pred>
+size_t hash_map<K, V>::retain_if(Pred pred)
+{
+    return erase_if([&pred](const K &key, const V &value) { return !pred(key, value); });
+}
+
+template <typename K, typename V>
+template <typename Resolve>
+void hash_map<K, V>::merge_from(const hash_map &other, Resolve resolve, size_t threads)
+{
+    if (this == &other)
+    {
+        return;
+    }
+    _finish_rehash();
+    other._finish_rehash();
+
+    auto copy_buckets = [&](size_t begin, size_t end) {
+        _bulk_result result;
+        for (size_t i = begin; i < end; i++)
+        {
+            for (node<K, V> *theirs = other._head[i].front(); theirs != NULL; theirs = theirs->next)
+            {
+                _merge_node(theirs, false, other._resource, resolve, result);
+            }
+        }
+        return result;
+    };
+
+    // a key lands in the same bucket index in both maps only if their capacities match
+    _for_bucket_ranges(other._capacity, _capacity == other._capacity ? threads : 1, copy_buckets);
+#ifdef HASH_MAP_CACHE
+    // merged nodes are linked straight into their buckets, so the budget is enforced once here
+    _evict_for(0);
+#endif
+    _fit_capacity();
+}
+
+template <typename K, typename V>
+template <typename Resolve>
+void hash_map<K, V>::merge_from(hash_map &&other, Resolve resolve, size_t threads)
+{
+    if (this == &other)
+    {
+        return;
+    }
+    _finish_rehash();
+    other._finish_rehash();
+
+    auto splice_buckets = [&](size_t begin, size_t end) {
+        _bulk_result result;
+        for (size_t i = begin; i < end; i++)
+        {
+            while (node<K, V> *theirs = other._head[i].pop_front())
+            {
+                other._on_unlink(theirs);
+                result.other_size_delta--;
+                _merge_node(theirs, true, other._resource, resolve, result);
+            }
+        }
+        return result;
+    };
+
+    // stolen nodes may be freed back into other's resource, so that has to be thread safe too
+    bool parallel = _capacity == other._capacity && _thread_safe(other._resource);
+    _bulk_result moved = _for_bucket_ranges(other._capacity, parallel ? threads : 1, splice_buckets);
+    other._size += moved.other_size_delta;
+    other._fit_capacity();
+#ifdef HASH_MAP_CACHE
+    _evict_for(0);
+#endif
+    _fit_capacity();
+}
+
+template <typename K, typename V>
+template <typename Resolve>
+void hash_map<K, V>::intersect_with(const hash_map &other, Resolve resolve, size_t threads)
+{
+    _finish_rehash();
+    other._finish_rehash();
+    // only this map's buckets are written, so ranges can run in parallel whatever other's capacity
+    auto intersect_buckets = [&](size_t begin, size_t end) {
+        _bulk_result result;
+        for (size_t i = begin; i < end; i++)
+        {
+            node<K, V> **link = _head[i].front_link();
+            while (*link != NULL)
+            {
+                node<K, V> *mine = *link;
+                size_t probes = 0;
+                size_t hash = _node_hash(mine);
+                node<K, V> *theirs = other._head[hash % other._capacity].find_node(mine->key, hash, probes);
+
+                if (theirs == NULL || !_live(theirs) || !_live(mine))
+                {
+                    _on_unlink(mine);
+                    _delnode(_resource, _head[i].unlink_at(link));
+                    result.size_delta--;
+                    result.removes++;
+                    continue;
+                }
+
+                mine->value = resolve(mine->key, mine->value, theirs->value);
+                result.updates++;
+                link = &mine->next;
+            }
+        }
+        return result;
+    };
+
+    _for_bucket_ranges(_capacity, threads, intersect_buckets);
+    _fit_capacity();
+}
+
+template <typename K, typename V>
+void hash_map<K, V>::difference(const hash_map &other, size_t threads)
+{
+    _finish_rehash();
+    other._finish_rehash();
+    auto remove_buckets = [&](size_t begin, size_t end) {
+        _bulk_result result;
+        for (size_t i = begin; i < end; i++)
+        {
+            node<K, V> **link = _head[i].front_link();
+            while (*link != NULL)
+            {
+                node<K, V> *mine = *link;
+                size_t probes = 0;
+                size_t hash = _node_hash(mine);
+                node<K, V> *theirs = other._head[hash % other._capacity].find_node(mine->key, hash, probes);
+
+                if (theirs != NULL && _live(theirs))
+                {
+                    _on_unlink(mine);
+                    _delnode(_resource, _head[i].unlink_at(link));
+                    result.size_delta--;
+                    result.removes++;
+                    continue;
+                }
+                link = &mine->next;
+            }
+        }
+        return result;
+    };
+
+    _for_bucket_ranges(_capacity, threads, remove_buckets);
+    _fit_capacity();
+}
+
+template <typename K, typename V>
+void hash_map<K, V>::bulk_insert(const std::pair<K, V> *pairs, size_t count, size_t threads)
+{
+    _finish_rehash();
+
+    // size the table for the input up front as if no key repeats, so nothing rehashes midway
+    size_t num_capacities = sizeof(_capacities) / sizeof(_capacities[0]);
+    size_t target = _capacity;
+    for (size_t i = 0; i < num_capacities && _size + count > _upper_load_factor * target; i++)
+    {
+        target = std::max(target, _capacities[i]);
+    }
+    if (target != _capacity)
+    {
+        rehash(target);
+    }
+
+    if (threads == 0)
+    {
+        threads = std::max(std::thread::hardware_concurrency(), 1u);
+    }
+    size_t chunks = std::min(threads, std::max<size_t>(count / _min_pairs_per_thread, 1));
+    size_t per_chunk = (count + chunks - 1) / chunks;
+
+    // offsets[c * _capacity + b] counts chunk c's pairs for bucket b, then becomes where
+    // the next of them goes in order. Walking the chunks in input order keeps it stable
+    std::vector<size_t> offsets(chunks * _capacity, 0);
+    std::vector<size_t> bucket_start(_capacity + 1, 0);
+    std::vector<size_t> order(count);
+    std::vector<size_t> hashes(count);
+
+    auto count_chunks = [&](size_t begin, size_t end) {
+        for (size_t c = begin; c < end; c++)
+        {
+            for (size_t i = c * per_chunk; i < std::min(count, (c + 1) * per_chunk); i++)
+            {
+                hashes[i] = _hash(pairs[i].first);
+                offsets[c * _capacity + hashes[i] % _capacity]++;
+            }
+        }
+        return _bulk_result();
+    };
+    _for_bucket_ranges(chunks, chunks, count_chunks, 1);
+
+    size_t running = 0;
+    for (size_t b = 0; b < _capacity; b++)
+    {
+        bucket_start[b] = running;
+        for (size_t c = 0; c < chunks; c++)
+        {
+            size_t pairs_here = offsets[c * _capacity + b];
+            offsets[c * _capacity + b] = running;
+            running += pairs_here;
+        }
+    }
+    bucket_start[_capacity] = running;
+
+    auto scatter_chunks = [&](size_t begin, size_t end) {
+        for (size_t c = begin; c < end; c++)
+        {
+            for (size_t i = c * per_chunk; i < std::min(count, (c + 1) * per_chunk); i++)
+            {
+                order[offsets[c * _capacity + hashes[i] % _capacity]++] = i;
+            }
+        }
+        return _bulk_result();
+    };
+    _for_bucket_ranges(chunks, chunks, scatter_chunks, 1);
+
+    // each bucket's pairs are now contiguous and in input order, so later pairs overwrite
+    auto fill_buckets = [&](size_t begin, size_t end) {
+        _bulk_result result;
+        for (size_t b = begin; b < end; b++)
+        {
+            for (size_t j = bucket_start[b]; j < bucket_start[b + 1]; j++)
+            {
+                const std::pair<K, V> &pair = pairs[order[j]];
+                size_t hash = hashes[order[j]];
+                size_t probes = 0;
+                node<K, V> **slot = _dense_slot(pair.first);
+                node<K, V> **link =
+                    slot != NULL ? _head[b].front_link() : _head[b].find_link(pair.first, hash, probes);
+                node<K, V> *existing = slot != NULL ? *slot : *link;
+
+                if (existing != NULL)
+                {
+#ifdef HASH_MAP_TTL
+                    if (_expired(existing))
+                    {
+                        _wheel.cancel(existing);
+                        existing->expires_at = 0;
+                    }
+#endif
+                    existing->value = pair.second;
+                    result.updates++;
+                    continue;
+                }
+
+                node<K, V> *added = _insnode(_resource, pair.first, pair.second);
+#ifdef HASH_MAP_STORE_HASH
+                added->hash = hash;
+#endif
+                _head[b].link_at(link, added);
+                _on_link(added);
+                result.size_delta++;
+                result.inserts++;
+                result.allocations++;
+            }
+        }
+        return result;
+    };
+    _for_bucket_ranges(_capacity, chunks, fill_buckets, 1);
+#ifdef HASH_MAP_CACHE
+    // the fill links nodes straight into their buckets, so the budget is enforced once here
+    _evict_for(0);
+#endif
+    _fit_capacity();
+}
+
+template <typename K, typename V>
+template <typename Work>
+typename hash_map<K, V>::_bulk_result hash_map<K, V>::_for_bucket_ranges(size_t num_buckets,
+                                                                         size_t threads,
+                                                                         Work work,
+                                                                         size_t min_buckets)
+{
+    if (threads == 0)
+    {
+        threads = std::max(std::thread::hardware_concurrency(), 1u);
+    }
+    threads = std::min(threads, std::max<size_t>(num_buckets / min_buckets, 1));
+    if (!_thread_safe(_resource))
+    {
+        threads = 1;
+    }
+#if defined(HASH_MAP_CACHE) || defined(HASH_MAP_TTL)
+    threads = 1;
+#endif
+
+    size_t per_thread = (num_buckets + threads - 1) / threads;
+    std::vector<_bulk_result> results(threads);
+    std::vector<std::thread> workers;
+
+    for (size_t t = 1; t < threads; t++)
+    {
+        size_t begin = std::min(t * per_thread, num_buckets);
+        size_t end = std::min(begin + per_thread, num_buckets);
+        workers.emplace_back([&results, &work, t, begin, end]() { results[t] = work(begin, end); });
+    }
+    results[0] = work(0, std::min(per_thread, num_buckets));
+
+    _bulk_result total;
+    for (size_t t = 0; t < threads; t++)
+    {
+        if (t > 0)
+        {
+            workers[t - 1].join();
+        }
+        total.size_delta += results[t].size_delta;
+        total.other_size_delta += results[t].other_size_delta;
+        total.inserts += results[t].inserts;
+        total.updates += results[t].updates;
+        total.removes += results[t].removes;
+        total.allocations += results[t].allocations;
+    }
+
+    _size += total.size_delta;
+    HASH_MAP_STAT(_stats.inserts += total.inserts);
+    HASH_MAP_STAT(_stats.updates += total.updates);
+    HASH_MAP_STAT(_stats.removes += total.removes);
+    HASH_MAP_STAT(_stats.bytes_allocated += total.allocations * sizeof(node<K, V>));
+    return total;
+}
+
+template <typename K, typename V>
+template <typename Resolve>
+void hash_map<K, V>::_merge_node(node<K, V> *theirs, bool steal, std::pmr::memory_resource *their_resource,
+                                 Resolve &resolve, _bulk_result &result)
+{
+    if (!_live(theirs))
+    {
+        if (steal)
+        {
+            _delnode(their_resource, theirs);
+        }
+        return;
+    }
+
+    size_t hash = _node_hash(theirs);
+    size_t i = hash % _capacity;
+    size_t probes = 0;
+    node<K, V> **link = _head[i].find_link(theirs->key, hash, probes);
+    node<K, V> *mine = *link;
+
+    // an expired entry of ours is as good as absent, so drop it and take theirs
+    if (mine != NULL && !_live(mine))
+    {
+        _on_unlink(mine);
+        _delnode(_resource, _head[i].unlink_at(link));
+        result.size_delta--;
+        mine = NULL;
+    }
+
+    if (mine != NULL)
+    {
+        mine->value = resolve(mine->key, mine->value, theirs->value);
+        result.updates++;
+        if (steal)
+        {
+            _delnode(their_resource, theirs);
+        }
+        return;
+    }
+
+    // a copied node keeps per-node state such as its expiry. A stolen node can only be
+    // kept if this map's resource is able to free it later
+    node<K, V> *added = theirs;
+    if (!steal || !_resource->is_equal(*their_resource))
+    {
+        added = _copynode(_resource, *theirs);
+        result.allocations++;
+        if (steal)
+        {
+            _delnode(their_resource, theirs);
+        }
+    }
+    _head[i].link_at(link, added);
+    _on_link(added);
+    result.size_delta++;
+    result.inserts++;
+}
+
+#ifdef HASH_MAP_CACHE
+template <typename K, typename V>
+void hash_map<K, V>::set_cache_limits(size_t max_entries, size_t max_bytes)
+{
+    _rehash_lock guard(*this);
+    _max_entries = max_entries == 0 ? SIZE_MAX : max_entries;
+    if (max_bytes != 0)
+    {
+        _max_entries = std::min(_max_entries, std::max<size_t>(max_bytes / sizeof(node<K, V>), 1));
+    }
+
+    if (_size > _max_entries)
+    {
+        _evict_for(0);
+        _fit_capacity();
+    }
+}
+
+template <typename K, typename V>
+template <typename Loader>
+V hash_map<K, V>::get_or_load(K key, Loader loader)
+{
+    std::optional<V> cached = get_value(key);
+    if (cached.has_value())
+    {
+        return cached.value();
+    }
+
+    V loaded = loader(key);
+    insert(key, loaded);
+    return loaded;
+}
+
+template <typename K, typename V>
+void hash_map<K, V>::_evict_for(size_t room)
+{
+    while (_clock_hand != NULL && _size + room > _max_entries)
+    {
+        node<K, V> *candidate = _clock_hand;
+
+        // a node read since the last sweep gets a second chance
+        if (candidate->referenced)
+        {
+            candidate->referenced = false;
+            _clock_hand = candidate->clock_next;
+            continue;
+        }
+
+        size_t hash = _node_hash(candidate);
+        hash_list<K, V> &chain = _chain(hash);
+        size_t probes = 0;
+        node<K, V> **link = chain.find_link(candidate->key, hash, probes);
+        _on_unlink(candidate);
+        _delnode(_resource, chain.unlink_at(link));
+        _size--;
+        HASH_MAP_STAT(_stats.evictions++);
+    }
+}
+#endif
+
+#ifdef HASH_MAP_TTL
+template <typename K, typename V>
+void hash_map<K, V>::insert(K key, V value, std::chrono::steady_clock::duration ttl)
+{
+    _rehash_lock guard(*this);
+    node<K, V> *entry = _insert_node(key, value);
+    _wheel.cancel(entry);
+    entry->expires_at = _tick(std::chrono::steady_clock::now() + ttl);
+    _wheel.schedule(entry, _tick(std::chrono::steady_clock::now()));
+}
+
+template <typename K, typename V>
+bool hash_map<K, V>::set_expiry(K key, std::chrono::steady_clock::time_point when)
+{
+    _rehash_lock guard(*this);
+    size_t probes = 0;
+    size_t hash = _hash(key);
+    node<K, V> *entry = _chain(hash).find_node(key, hash, probes);
+
+    if (entry == NULL || _expired(entry))
+    {
+        return false;
+    }
+
+    _wheel.cancel(entry);
+    entry->expires_at = _tick(when);
+    _wheel.schedule(entry, _tick(std::chrono::steady_clock::now()));
+    return true;
+}
+
+template <typename K, typename V>
+size_t hash_map<K, V>::remove_expired(size_t max_batch, std::chrono::steady_clock::time_point now)
+{
+    _rehash_lock guard(*this);
+    size_t removed = _wheel.advance(_tick(now), max_batch, [this](node<K, V> *expired) {
+        size_t hash = _node_hash(expired);
+        hash_list<K, V> &chain = _chain(hash);
+        size_t probes = 0;
+        node<K, V> **link = chain.find_link(expired->key, hash, probes);
+        _on_unlink(expired);
+        _delnode(_resource, chain.unlink_at(link));
+        _size--;
+        HASH_MAP_STAT(_stats.expirations++);
+    });
+
+    // one capacity check for the whole batch
+    if (removed != 0)
+    {
+        _fit_capacity();
+    }
+    return removed;
+}
+
+template <typename K, typename V>
+uint64_t hash_map<K, V>::_tick(std::chrono::steady_clock::time_point when)
+{
+    int64_t ms = std::chrono::duration_cast<std::chrono::milliseconds>(when.time_since_epoch()).count();
+
+    // 0 means "never expires", so the earliest representable tick is 1
+    return ms < 1 ? 1 : ms;
+}
+
+template <typename K, typename V>
+bool hash_map<K, V>::_expired(const node<K, V> *entry)
+{
+    return entry->expires_at != 0 && entry->expires_at <= _tick(std::chrono::steady_clock::now());
+}
+#endif
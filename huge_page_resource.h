@@ -0,0 +1,83 @@
+#ifndef HUGE_PAGE_RESOURCE_H
+#define HUGE_PAGE_RESOURCE_H
+
+#include <memory_resource>
+#include <vector>
+#include <stddef.h>
+
+/**
+ * A memory resource that backs its allocations with 2 MB huge pages, so a hash_map's
+ * bucket array and nodes need far fewer TLB entries than with 4 KB pages. Each mapping
+ * first asks for reserved huge pages (MAP_HUGETLB). If none are reserved it falls back to
+ * a 2 MB aligned ordinary mapping marked with madvise(MADV_HUGEPAGE), which transparent
+ * huge pages can back.
+ *
+ * Allocations of at least half a page get a mapping of their own that is unmapped when
+ * they're deallocated. Smaller ones are carved out of shared 2 MB slabs and only returned
+ * when the resource is destroyed, so this is meant to sit under a pool resource that
+ * recycles small blocks itself:
+ *
+ *     huge_page_resource pages;
+ *     std::pmr::unsynchronized_pool_resource pool(&pages);
+ *     hash_map<K, V> map(capacity, upper, lower, &pool);
+ *
+ * Not thread safe.
+ */
+class huge_page_resource : public std::pmr::memory_resource
+{
+
+public:
+    /** The size of a huge page, which every mapping is rounded up to */
+    static constexpr size_t page_size = size_t(2) << 20;
+
+    /** Create a resource that hasn't mapped anything yet */
+    huge_page_resource();
+
+    huge_page_resource(const huge_page_resource &other) = delete;
+    huge_page_resource &operator=(const huge_page_resource &other) = delete;
+
+    /** Unmap every slab. Blocks of their own must already have been deallocated */
+    ~huge_page_resource();
+
+    /** Return the number of mappings backed by reserved huge pages */
+    size_t get_hugetlb_mappings() const;
+
+    /** Return the number of mappings that fell back to madvise(MADV_HUGEPAGE) */
+    size_t get_advised_mappings() const;
+
+    /** Return the number of bytes currently mapped */
+    size_t get_bytes_mapped() const;
+
+protected:
+    void *do_allocate(size_t bytes, size_t alignment) override;
+
+    void do_deallocate(void *p, size_t bytes, size_t alignment) override;
+
+    bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override;
+
+private:
+    /** Map length bytes, which must be a multiple of page_size, aligned to page_size */
+    void *_map(size_t length);
+
+    /** Unmap a mapping returned by _map */
+    void _unmap(void *base, size_t length);
+
+    /** Round bytes up to a whole number of huge pages */
+    static size_t _round_up(size_t bytes);
+
+    /** Every slab mapped for small blocks. The last one is the one being carved up */
+    std::vector<char *> _slabs;
+
+    /** The number of bytes of the last slab already handed out */
+    size_t _slab_used;
+
+    /** The counts returned by the getters */
+    size_t _hugetlb_mappings;
+    size_t _advised_mappings;
+    size_t _bytes_mapped;
+};
+
+/** See hash_list.h for an explanation of why this odd line of code is here */
+#include "huge_page_resource.hpp"
+
+#endif
@@ -0,0 +1,129 @@
+#include "huge_page_resource.h"
+
+#include <new>
+#include <stdint.h>
+#include <sys/mman.h>
+
+inline huge_page_resource::huge_page_resource()
+{
+    _slab_used = page_size;
+    _hugetlb_mappings = 0;
+    _advised_mappings = 0;
+    _bytes_mapped = 0;
+}
+
+inline huge_page_resource::~huge_page_resource()
+{
+    for (char *slab : _slabs)
+    {
+        _unmap(slab, page_size);
+    }
+}
+
+inline size_t huge_page_resource::get_hugetlb_mappings() const
+{
+    return _hugetlb_mappings;
+}
+
+inline size_t huge_page_resource::get_advised_mappings() const
+{
+    return _advised_mappings;
+}
+
+inline size_t huge_page_resource::get_bytes_mapped() const
+{
+    return _bytes_mapped;
+}
+
+inline void *huge_page_resource::do_allocate(size_t bytes, size_t alignment)
+{
+    if (alignment > page_size)
+    {
+        throw std::bad_alloc();
+    }
+
+    if (bytes >= page_size / 2)
+    {
+        return _map(_round_up(bytes));
+    }
+
+    size_t offset = (_slab_used + alignment - 1) & ~(alignment - 1);
+    if (_slabs.empty() || offset + bytes > page_size)
+    {
+        // reserve first so a failed push_back can't leak the new slab
+        _slabs.reserve(_slabs.size() + 1);
+        _slabs.push_back(static_cast<char *>(_map(page_size)));
+        offset = 0;
+    }
+    _slab_used = offset + bytes;
+    return _slabs.back() + offset;
+}
+
+inline void huge_page_resource::do_deallocate(void *p, size_t bytes, size_t alignment)
+{
+    (void)alignment;
+
+    // small blocks live in a shared slab until the resource goes away
+    if (bytes >= page_size / 2)
+    {
+        _unmap(p, _round_up(bytes));
+    }
+}
+
+inline bool huge_page_resource::do_is_equal(const std::pmr::memory_resource &other) const noexcept
+{
+    return this == &other;
+}
+
+inline void *huge_page_resource::_map(size_t length)
+{
+#ifdef MAP_HUGETLB
+    void *huge = mmap(NULL, length, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (huge != MAP_FAILED)
+    {
+        _hugetlb_mappings++;
+        _bytes_mapped += length;
+        return huge;
+    }
+#endif
+
+    // no reserved huge pages, so over-map by a page to find a 2 MB aligned range that
+    // transparent huge pages can back, and give the unaligned ends back
+    char *raw = static_cast<char *>(mmap(NULL, length + page_size, PROT_READ | PROT_WRITE,
+                                         MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+    if (raw == MAP_FAILED)
+    {
+        throw std::bad_alloc();
+    }
+
+    char *aligned = reinterpret_cast<char *>((reinterpret_cast<uintptr_t>(raw) + page_size - 1) &
+                                             ~uintptr_t(page_size - 1));
+    if (aligned != raw)
+    {
+        munmap(raw, aligned - raw);
+    }
+    if (aligned + length != raw + length + page_size)
+    {
+        munmap(aligned + length, raw + page_size - aligned);
+    }
+
+#ifdef MADV_HUGEPAGE
+    // only a hint; without THP this is still a working ordinary mapping
+    madvise(aligned, length, MADV_HUGEPAGE);
+#endif
+    _advised_mappings++;
+    _bytes_mapped += length;
+    return aligned;
+}
+
+inline void huge_page_resource::_unmap(void *base, size_t length)
+{
+    munmap(base, length);
+    _bytes_mapped -= length;
+}
+
+inline size_t huge_page_resource::_round_up(size_t bytes)
+{
+    return (bytes + page_size - 1) & ~(page_size - 1);
+}
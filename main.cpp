@@ -1,6 +1,12 @@
 #include <iostream>
+#include <chrono>
+#include <memory_resource>
+#include <string>
+#include <vector>
 
 #include "hash_map.h"
+#include "huge_page_resource.h"
+#include "static_hash_map.h"
 
 int main(int argc, char *argv[])
 {
@@ -38,4 +44,526 @@ int main(int argc, char *argv[])
         std::cout << "Unexpected 3 in map" << std::endl;
         exit(1);
     }
+
+    hash_map<int, float> left(11, 0.75, 0.25);
+    hash_map<int, float> right(11, 0.75, 0.25);
+    auto sum = [](const int &, const float &mine, const float &theirs) { return mine + theirs; };
+
+    left.insert(1, 1);
+    left.insert(2, 2);
+    right.insert(2, 20);
+    right.insert(3, 30);
+    left.merge_from(right, sum);
+
+    if (left.get_size() != 3 || left.get_value(2).value() != 22 || left.get_value(3).value() != 30)
+    {
+        std::cout << "merge_from produced the wrong entries" << std::endl;
+        exit(1);
+    }
+
+    left.intersect_with(right, sum);
+
+    if (left.get_size() != 2 || left.get_value(2).value() != 42 || left.get_value(1).has_value())
+    {
+        std::cout << "intersect_with produced the wrong entries" << std::endl;
+        exit(1);
+    }
+
+    left.difference(right);
+    left.merge_from(std::move(right), sum);
+
+    if (left.get_size() != 2 || right.get_size() != 0 || left.get_value(3).value() != 30)
+    {
+        std::cout << "difference or moving merge_from produced the wrong entries" << std::endl;
+        exit(1);
+    }
+
+    for (int i = 0; i < 100; i++)
+    {
+        left.insert(i, i);
+    }
+
+    if (left.erase_if([](const int &key, const float &) { return key % 2 == 0; }) != 50 ||
+        left.retain_if([](const int &key, const float &) { return key < 51; }) != 25 ||
+        left.get_size() != 25 || left.get_value(50).has_value() || !left.get_value(49).has_value())
+    {
+        std::cout << "erase_if/retain_if removed the wrong entries" << std::endl;
+        exit(1);
+    }
+
+    // everything comes out of the arena, so a null default resource must never be touched
+    {
+        static char buffer[1 << 20];
+        std::pmr::monotonic_buffer_resource arena(buffer, sizeof(buffer), std::pmr::null_memory_resource());
+        std::pmr::memory_resource *previous = std::pmr::set_default_resource(std::pmr::null_memory_resource());
+        hash_map<int, float> scoped(209, 0.7, 0.2, &arena);
+        for (int i = 0; i < 500; i++)
+        {
+            scoped.insert(i, i);
+        }
+        scoped.remove(7);
+        hash_map<int, float> outside(scoped, std::pmr::new_delete_resource());
+        std::pmr::set_default_resource(previous);
+
+        outside.merge_from(std::move(scoped), [](const int &, const float &mine, const float &) { return mine; });
+        if (scoped.get_resource() != &arena || outside.get_size() != 499 || scoped.get_size() != 0 ||
+            outside.get_value(499).value_or(0) != 499 || outside.get_value(7).has_value())
+        {
+            std::cout << "arena backed hash_map lost entries" << std::endl;
+            exit(1);
+        }
+    }
+
+    {
+        huge_page_resource pages;
+        std::pmr::unsynchronized_pool_resource pool(&pages);
+        hash_map<int, float> paged(209, 0.7, 0.2, &pool);
+        for (int i = 0; i < 2000; i++)
+        {
+            paged.insert(i, i);
+        }
+        if (paged.get_value(1999).value_or(0) != 1999 || pages.get_bytes_mapped() % huge_page_resource::page_size != 0 ||
+            pages.get_hugetlb_mappings() + pages.get_advised_mappings() == 0)
+        {
+            std::cout << "huge page backed hash_map failed" << std::endl;
+            exit(1);
+        }
+    }
+
+    // keys inside and outside the dense range must behave the same
+    {
+        hash_map<int, float> dense(209, 0.7, 0.2);
+        dense.insert(-5, -5);
+        dense.insert(10, 10);
+        dense.set_dense_range(0, 1000);
+        for (int i = 0; i < 1200; i++)
+        {
+            dense.insert(i, i);
+        }
+        dense.remove(10);
+        dense.remove(1100);
+        dense.erase_if([](const int &key, const float &) { return key % 100 == 1; });
+        hash_map<int, float> copy = dense;
+        if (copy.get_size() != 1187 || copy.get_value(10).has_value() || copy.get_value(1100).has_value() ||
+            copy.get_value(101).has_value() || copy.get_value(999).value_or(0) != 999 ||
+            copy.get_value(-5).value_or(0) != -5 || copy.get_value(1199).value_or(0) != 1199 ||
+            copy.remove(1001) || !copy.remove(1002) || copy.get_value(1002).has_value())
+        {
+            std::cout << "dense range lookups disagree with hashing" << std::endl;
+            exit(1);
+        }
+    }
+
+    // built and looked up entirely at compile time
+    constexpr static_hash_map<std::string_view, int, 4> ports{{"http", 80}, {"ssh", 22}, {"http", 8080}};
+    static_assert(ports.get_size() == 2 && ports.get_value("http").value() == 8080);
+    static_assert(!ports.get_value("ftp").has_value());
+    {
+        static_hash_map<int, float, 64> fixed;
+        for (int i = 0; i < 70; i++)
+        {
+            if (fixed.insert(i, i) != (i < 64))
+            {
+                std::cout << "static_hash_map accepted too many keys" << std::endl;
+                exit(1);
+            }
+        }
+        for (int i = 0; i < 64; i += 3)
+        {
+            fixed.remove(i);
+        }
+        if (fixed.get_size() != 42 || fixed.get_value(3).has_value() || fixed.get_value(62).value_or(0) != 62 ||
+            !fixed.insert(100, 100) || fixed.get_value(100).value_or(0) != 100)
+        {
+            std::cout << "static_hash_map lost entries" << std::endl;
+            exit(1);
+        }
+    }
+
+    {
+        hash_map<int, float> live(209, 0.7, 0.2);
+        for (int i = -500; i < 1500; i += 3)
+        {
+            live.insert(i, i);
+        }
+        frozen_hash_map<int, float> frozen = live.freeze();
+        for (int i = -600; i < 1600; i++)
+        {
+            if (frozen.get_value(i) != live.get_value(i))
+            {
+                std::cout << "frozen map disagrees with the live map at " << i << std::endl;
+                exit(1);
+            }
+        }
+        if (frozen.get_size() != live.get_size() || hash_map<int, float>(1021, 0.7, 0.2).freeze().get_value(0).has_value())
+        {
+            std::cout << "frozen map has the wrong size" << std::endl;
+            exit(1);
+        }
+    }
+
+    // repeated keys keep their last value whatever the thread count
+    {
+        std::vector<std::pair<int, float>> pairs;
+        for (int i = 0; i < 50000; i++)
+        {
+            pairs.emplace_back((i * 7919) % 1700, i);
+        }
+        hash_map<int, float> serial(209, 0.7, 0.2);
+        for (const std::pair<int, float> &pair : pairs)
+        {
+            serial.insert(pair.first, pair.second);
+        }
+        hash_map<int, float> built(209, 0.7, 0.2);
+        built.insert(5, -1);
+        built.bulk_insert(pairs.data(), pairs.size(), 4);
+        if (built.get_size() != serial.get_size() || built.get_capacity() != serial.get_capacity())
+        {
+            std::cout << "bulk_insert built the wrong table" << std::endl;
+            exit(1);
+        }
+        for (int key = 0; key < 1700; key++)
+        {
+            if (built.get_value(key) != serial.get_value(key))
+            {
+                std::cout << "bulk_insert kept the wrong value for " << key << std::endl;
+                exit(1);
+            }
+        }
+    }
+
+    // the same node moves between maps and lists
+    {
+        hash_map<int, float> hot(209, 0.7, 0.2);
+        hash_map<int, float> cold(209, 0.7, 0.2);
+        for (int i = 0; i < 100; i++)
+        {
+            hot.insert(i, i);
+        }
+        cold.insert(7, -7);
+
+        node_handle<int, float> handle = hot.extract(7);
+        const float *value = &handle.value();
+        if (handle.empty() || handle.key() != 7 || hot.get_size() != 99 || hot.get_value(7).has_value() ||
+            cold.insert(std::move(handle)) || handle.empty() || !hot.extract(1000).empty())
+        {
+            std::cout << "extract or a duplicate insert went wrong" << std::endl;
+            exit(1);
+        }
+        cold.remove(7);
+        hash_list<int, float> list;
+        if (!cold.insert(std::move(handle)) || !handle.empty() || cold.get_value(7).value_or(0) != 7 ||
+            !list.insert(cold.extract(7)) || &list.extract(7).value() != value)
+        {
+            std::cout << "node handle insert went wrong" << std::endl;
+            exit(1);
+        }
+    }
+
+    // try_emplace leaves an existing value and its arguments alone, insert_or_assign doesn't
+    {
+        hash_map<std::string, std::string> names(209, 0.7, 0.2);
+        std::string value = "first";
+        std::pair<std::string *, bool> placed = names.try_emplace("a", std::move(value));
+        std::string second = "second";
+        std::pair<std::string *, bool> kept = names.try_emplace("a", std::move(second));
+        if (!placed.second || kept.second || kept.first != placed.first || *kept.first != "first" ||
+            second != "second")
+        {
+            std::cout << "try_emplace went wrong" << std::endl;
+            exit(1);
+        }
+        std::pair<std::string *, bool> assigned = names.insert_or_assign("a", std::move(second));
+        std::pair<std::string *, bool> built = names.emplace("b", 3, 'b');
+        std::pair<std::string *, bool> dropped = names.emplace("b", "ignored");
+        if (assigned.second || assigned.first != placed.first || *names.get_value("a") != "second" ||
+            !built.second || *built.first != "bbb" || dropped.second || dropped.first != built.first ||
+            names.get_size() != 2)
+        {
+            std::cout << "insert_or_assign or emplace went wrong" << std::endl;
+            exit(1);
+        }
+
+        // find hands out the stored value itself, which survives the table growing
+        std::string *a = names.find("a");
+        *a += "!";
+        for (int i = 0; i < 1000; i++)
+        {
+            names.insert(std::to_string(i), "");
+        }
+        const hash_map<std::string, std::string> &view = names;
+        if (a != placed.first || view.find("a") != a || *a != "second!" || view.find("z") != NULL ||
+            !view.contains("b") || view.contains("z"))
+        {
+            std::cout << "find or contains went wrong" << std::endl;
+            exit(1);
+        }
+    }
+
+    // looking up by string_view never builds a key, so the null default resource goes untouched
+    {
+        hash_map<std::pmr::string, int> words(209, 0.7, 0.2);
+        words.insert(std::pmr::string("a key long enough to live on the heap"), 1);
+        words.insert(std::pmr::string("another key long enough to live on the heap"), 2);
+        std::string_view buffer = "a key long enough to live on the heap, then more";
+        std::string_view first = buffer.substr(0, buffer.find(','));
+
+        std::pmr::memory_resource *previous = std::pmr::set_default_resource(std::pmr::null_memory_resource());
+        bool found = words.contains(first) && words.find(first) != NULL && words.get_value(first) == 1 &&
+                     !words.contains(buffer) && words.remove(first) && !words.remove(first) &&
+                     words.contains("another key long enough to live on the heap");
+        std::pmr::set_default_resource(previous);
+        if (!found || words.get_size() != 1)
+        {
+            std::cout << "transparent lookup went wrong" << std::endl;
+            exit(1);
+        }
+    }
+
+    // keys sharing a residue pile into one bucket, which switches to a tree and back
+    {
+        hash_list<int, float> chain;
+        for (int i = 0; i < 100; i++)
+        {
+            chain.insert(i * 2039, i);
+        }
+        bool grown = chain.is_treeified();
+        hash_list<int, float> copy = chain;
+        for (int i = 0; i < 97; i++)
+        {
+            chain.remove(i * 2039);
+        }
+        if (!grown || !copy.is_treeified() || chain.is_treeified() || chain.get_size() != 3 ||
+            chain.get_value(99 * 2039).value_or(0) != 99 || copy.get_value(5 * 2039).value_or(0) != 5)
+        {
+            std::cout << "treeified bucket went wrong" << std::endl;
+            exit(1);
+        }
+
+        hash_map<int, float> piled(209, 0.7, 0.2);
+        for (int i = 0; i < 5000; i++)
+        {
+            piled.insert(i * 2039, i);
+        }
+        for (int i = 0; i < 5000; i += 2)
+        {
+            piled.remove(i * 2039);
+        }
+        for (int i = 0; i < 5000; i++)
+        {
+            if (piled.contains(i * 2039) != (i % 2 == 1) || piled.contains(i * 2039 + 1))
+            {
+                std::cout << "treeified map lost track of " << i * 2039 << std::endl;
+                exit(1);
+            }
+        }
+
+#ifdef HASH_MAP_STATS
+        // the trees of a full map take a few bytes a key, and the stats count them
+        hash_map<int, float> spread(209, 0.7, 0.2);
+        for (int i = 0; i < 100000; i++)
+        {
+            spread.insert(i, i);
+        }
+        hash_map_stats spread_stats = spread.stats();
+        if (piled.stats().index_bytes == 0 || spread_stats.index_bytes == 0 ||
+            spread_stats.index_bytes > 16 * spread.get_size() || spread_stats.bytes_allocated < spread_stats.bytes_in_use)
+        {
+            std::cout << "bucket trees aren't counted or take too much room" << std::endl;
+            exit(1);
+        }
+#endif
+    }
+
+    // a key read under a reordering policy moves towards the head of its chain
+    {
+        hash_list<int, float> chain;
+        for (int i = 0; i < 5; i++)
+        {
+            chain.insert(i, i);
+        }
+        size_t probes = 0;
+        chain.promote(chain.find_link(4, probes), false);
+        chain.promote(chain.find_link(3, probes), true);
+        size_t transposed = 0;
+        size_t fronted = 0;
+        chain.find_node(4, transposed);
+        chain.find_node(3, fronted);
+        if (transposed != 5 || fronted != 1 || chain.promote(chain.front_link(), true) || chain.get_size() != 5)
+        {
+            std::cout << "promote put the node in the wrong place" << std::endl;
+            exit(1);
+        }
+
+        hash_map<int, float> hot(209, 0.7, 0.2);
+        for (int i = 0; i < 100; i++)
+        {
+            hot.insert(i * 209, i);
+        }
+        hot.set_bucket_policy(bucket_policy::move_to_front);
+        const float *value = hot.find(99 * 209);
+        hot.set_bucket_policy(bucket_policy::transpose);
+        for (int i = 0; i < 100; i++)
+        {
+            if (hot.get_value(i * 209).value_or(-1) != i || !hot.contains(i * 209))
+            {
+                std::cout << "reordering lost " << i * 209 << std::endl;
+                exit(1);
+            }
+        }
+        if (hot.find(99 * 209) != value || hot.get_size() != 100)
+        {
+            std::cout << "reordering moved a value" << std::endl;
+            exit(1);
+        }
+    }
+
+#ifdef HASH_MAP_CACHE
+    hash_map<int, float> cache(11, 0.75, 0.25);
+    cache.set_cache_limits(2, 0);
+    cache.insert(1, 1);
+    cache.insert(2, 2);
+    cache.get_value(1);
+
+    /** 1 was read since it was inserted, so the CLOCK hand should pass it over and evict 2 */
+    cache.insert(3, 3);
+
+    if (cache.get_size() != 2 || !cache.get_value(1).has_value() || cache.get_value(2).has_value())
+    {
+        std::cout << "Cache evicted the wrong entry" << std::endl;
+        exit(1);
+    }
+
+    int loads = 0;
+    auto loader = [&loads](int key) { loads++; return key * 10.0f; };
+
+    if (cache.get_or_load(4, loader) != 40 || cache.get_or_load(4, loader) != 40 || loads != 1)
+    {
+        std::cout << "get_or_load didn't cache the loaded value" << std::endl;
+        exit(1);
+    }
+
+    // a bulk insert stays within the budget like single inserts do
+    {
+        std::vector<std::pair<int, float>> pairs;
+        for (int i = 0; i < 100; i++)
+        {
+            pairs.emplace_back(i, i);
+        }
+        hash_map<int, float> bounded(11, 0.75, 0.25);
+        bounded.set_cache_limits(10, 0);
+        bounded.bulk_insert(pairs.data(), pairs.size());
+        if (bounded.get_size() > 10)
+        {
+            std::cout << "bulk_insert overran the cache limit" << std::endl;
+            exit(1);
+        }
+
+        hash_map<int, float> source(11, 0.75, 0.25);
+        source.bulk_insert(pairs.data(), pairs.size());
+        hash_map<int, float> copied(11, 0.75, 0.25);
+        hash_map<int, float> moved(11, 0.75, 0.25);
+        copied.set_cache_limits(10, 0);
+        moved.set_cache_limits(10, 0);
+        copied.merge_from(source, sum);
+        moved.merge_from(std::move(source), sum);
+        if (copied.get_size() > 10 || moved.get_size() > 10)
+        {
+            std::cout << "merge_from overran the cache limit" << std::endl;
+            exit(1);
+        }
+    }
+#endif
+
+#ifdef HASH_MAP_TTL
+    hash_map<int, float> sessions(11, 0.75, 0.25);
+    auto now = std::chrono::steady_clock::now();
+
+    sessions.insert(1, 1, std::chrono::milliseconds(50));
+    sessions.insert(2, 2);
+    sessions.insert(3, 3, std::chrono::hours(1));
+    sessions.insert(4, 4, std::chrono::milliseconds(0));
+
+    if (sessions.get_value(4).has_value())
+    {
+        std::cout << "Expired key 4 was still visible" << std::endl;
+        exit(1);
+    }
+
+    if (sessions.remove_expired(10, now + std::chrono::seconds(1)) != 2 ||
+        sessions.get_size() != 2 || !sessions.get_value(2).has_value() || !sessions.get_value(3).has_value())
+    {
+        std::cout << "remove_expired removed the wrong entries" << std::endl;
+        exit(1);
+    }
+
+#ifdef HASH_MAP_STATS
+    // dropping an entry that had already expired isn't a remove
+    sessions.insert(5, 5, std::chrono::milliseconds(0));
+    size_t removes = sessions.stats().removes;
+    if (sessions.remove(5) || sessions.stats().removes != removes)
+    {
+        std::cout << "removing an expired key counted as a remove" << std::endl;
+        exit(1);
+    }
+    sessions.insert(6, 6, std::chrono::milliseconds(0));
+    if (!sessions.extract(6).empty() || sessions.stats().removes != removes)
+    {
+        std::cout << "extracting an expired key counted as a remove" << std::endl;
+        exit(1);
+    }
+
+    // erase_if sweeps expired entries away but only reports the ones pred matched
+    sessions.insert(7, 7, std::chrono::milliseconds(0));
+    sessions.insert(8, 8, std::chrono::milliseconds(0));
+    size_t expirations = sessions.stats().expirations;
+    if (sessions.erase_if([](const int &key, const float &) { return key == 2; }) != 1 ||
+        sessions.get_size() != 1 || sessions.stats().removes != removes + 1 ||
+        sessions.stats().expirations != expirations + 2)
+    {
+        std::cout << "erase_if counted expired entries as removes" << std::endl;
+        exit(1);
+    }
+#endif
+#endif
+
+#ifdef HASH_MAP_BACKGROUND_REHASH
+    // every step of growth and shrinkage happens on the worker while lookups carry on
+    {
+        hash_map<int, float> background(209, 0.7, 0.2);
+        for (int i = 0; i < 3000; i++)
+        {
+            background.insert(i, i);
+            if (background.get_value(i / 2).value_or(-1) != i / 2)
+            {
+                std::cout << "lookup failed during a background rehash" << std::endl;
+                exit(1);
+            }
+        }
+        if (background.get_capacity() != 2039 || background.get_size() != 3000)
+        {
+            std::cout << "background rehash did not grow the map" << std::endl;
+            exit(1);
+        }
+        for (int i = 0; i < 2990; i++)
+        {
+            background.remove(i);
+        }
+        if (background.get_capacity() != 209 || background.get_value(2995).value_or(0) != 2995)
+        {
+            std::cout << "background rehash did not shrink the map" << std::endl;
+            exit(1);
+        }
+    }
+#endif
+
+#ifdef HASH_MAP_STATS
+    hash_map_stats stats = map.stats();
+
+    if (stats.inserts != 2 || stats.removes != 1 || stats.hits != 1 || stats.misses != 1)
+    {
+        std::cout << "Unexpected counters in stats" << std::endl;
+        exit(1);
+    }
+#endif
 }
@@ -4,6 +4,8 @@
 
 #include "shared_testing_code.h"
 
+thread_local std::ostream *diagnostics = &std::cout;
+
 /** Determines how many points the default constructor is worth */
 std::string default_constructor_str("default_constructor");
 
@@ -72,7 +74,7 @@ parse_trace_file_points(std::ifstream &trace_file)
 
         if (delimeter_pos == std::string::npos)
         {
-            std::cout << "Error on line " << idx << ", expected delimeter " << delimeter
+            *diagnostics << "Error on line " << idx << ", expected delimeter " << delimeter
                       << " in current line but didn't find it" << std::endl;
         }
 
@@ -136,7 +138,7 @@ void write_test_results_to_file(test_results &default_results,
                                 bool write_copy_results,
                                 bool write_assignment_results,
                                 bool write_dynamic_size_sorted_keys,
-                                std::ofstream &grading_file)
+                                std::ostream &grading_file)
 {
     size_t total_score = 0;
 
@@ -176,7 +178,7 @@ void write_test_results_to_file(test_results &default_results,
 size_t calculate_score(test_results &results,
                        size_t multiplier,
                        bool write_dynamic_size_sorted_keys,
-                       std::ofstream &grading_file)
+                       std::ostream &grading_file)
 {
     size_t total_score = 0;
 
@@ -1,6 +1,7 @@
 #ifndef __SHARED_TESTING_CODE_H
 #define __SHARED_TESTING_CODE_H
 
+#include <fstream>
 #include <string>
 
 struct test_multipliers
@@ -53,6 +54,13 @@ struct test_results
     test_results();
 };
 
+/**
+ * Where the tests write diagnostics about failures. It's standard output unless a thread
+ * replaying a trace in parallel points it at a buffer of its own, which is written out in
+ * trace order later
+ */
+extern thread_local std::ostream *diagnostics;
+
 std::pair<test_results, test_multipliers> parse_trace_file_points(std::ifstream &trace_file);
 
 void write_test_results_to_file(test_results &default_results,
@@ -62,11 +70,11 @@ void write_test_results_to_file(test_results &default_results,
                                 bool write_copy_results,
                                 bool write_assignment_results,
                                 bool write_dynamic_size_sorted_keys,
-                                std::ofstream &grading_file);
+                                std::ostream &grading_file);
 
 size_t calculate_score(test_results &results,
                        size_t multiplier,
                        bool write_dynamic_size_sorted_keys,
-                       std::ofstream &grading_file);
+                       std::ostream &grading_file);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,113 @@
+#ifndef STATIC_HASH_MAP_H
+#define STATIC_HASH_MAP_H
+
+#include <initializer_list>
+#include <optional>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * A hash function that can run at compile time, unlike std::hash. Defined for integral
+ * types and std::string_view
+ */
+template <typename K, typename Enable = void>
+struct static_hash;
+
+template <typename K>
+struct static_hash<K, std::enable_if_t<std::is_integral<K>::value>>
+{
+    constexpr size_t operator()(K key) const;
+};
+
+template <>
+struct static_hash<std::string_view>
+{
+    constexpr size_t operator()(std::string_view key) const;
+};
+
+/**
+ * A hash map holding at most N entries in storage inside the object itself, so it never
+ * allocates. It chains like hash_map, but the links are indices into an inline entry array
+ * instead of pointers, which lets construction and lookup be constexpr:
+ *
+ *     constexpr static_hash_map<std::string_view, int, 4> ports{{"http", 80}, {"https", 443}};
+ *     static_assert(ports.get_value("https").value() == 443);
+ *
+ * K and V must be literal types with default constructors for the map to be usable in
+ * constant expressions.
+ */
+template <typename K, typename V, size_t N, typename Hash = static_hash<K>>
+class static_hash_map
+{
+    static_assert(N > 0, "a static_hash_map needs room for at least one entry");
+
+public:
+    /** Create an empty map */
+    constexpr static_hash_map();
+
+    /**
+     * Create a map holding the given pairs, later pairs overwriting earlier ones with the
+     * same key. More than N distinct keys is a compile error in a constant expression and
+     * throws std::length_error otherwise
+     */
+    constexpr static_hash_map(std::initializer_list<std::pair<K, V>> pairs);
+
+    /**
+     * Insert the key/value pair, or update the value if the key is already in the map.
+     * Returns false without changing anything if the key is new and the map is full
+     */
+    constexpr bool insert(K key, V value);
+
+    /** Return an optional containing the value for key, or an empty optional if it's absent */
+    constexpr std::optional<V> get_value(K key) const;
+
+    /** Remove key and return true, or return false if it isn't in the map */
+    constexpr bool remove(K key);
+
+    /** Return the number of key/value pairs in the map */
+    constexpr size_t get_size() const;
+
+    /** Return the most key/value pairs the map can hold, which is N */
+    constexpr size_t get_capacity() const;
+
+private:
+    /** Marks the end of a chain */
+    static constexpr size_t _none = SIZE_MAX;
+
+    struct _entry
+    {
+        K key = K();
+        V value = V();
+
+        /** The index of the next entry in the same bucket, or _none */
+        size_t next = _none;
+    };
+
+    /** Returns the index of the bucket that key belongs in */
+    constexpr size_t _bucket(const K &key) const;
+
+    /** Returns the address of the link to key's entry, or of the _none at its chain's end */
+    constexpr size_t *_find_link(const K &key);
+
+    /** Returns the index of key's entry, or _none */
+    constexpr size_t _find(const K &key) const;
+
+    /** The entries, packed into [0, _size) */
+    _entry _entries[N] = {};
+
+    /** The index of the first entry of each bucket, or _none */
+    size_t _buckets[N] = {};
+
+    /** The number of key/value pairs in the map */
+    size_t _size = 0;
+
+    Hash _hash = Hash();
+};
+
+/** See hash_list.h for an explanation of why this odd line of code is here */
+#include "static_hash_map.hpp"
+
+#endif
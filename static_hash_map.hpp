@@ -0,0 +1,150 @@
+#include "static_hash_map.h"
+
+#include <stdexcept>
+
+template <typename K>
+constexpr size_t static_hash<K, std::enable_if_t<std::is_integral<K>::value>>::operator()(K key) const
+{
+    // the murmur3 finalizer, so nearby keys don't land in nearby buckets
+    uint64_t x = uint64_t(key);
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return size_t(x);
+}
+
+constexpr size_t static_hash<std::string_view>::operator()(std::string_view key) const
+{
+    // 64 bit FNV-1a
+    uint64_t x = 0xcbf29ce484222325ULL;
+    for (char c : key)
+    {
+        x ^= uint64_t(static_cast<unsigned char>(c));
+        x *= 0x100000001b3ULL;
+    }
+    return size_t(x);
+}
+
+template <typename K, typename V, size_t N, typename Hash>
+constexpr static_hash_map<K, V, N, Hash>::static_hash_map()
+{
+    for (size_t i = 0; i < N; i++)
+    {
+        _buckets[i] = _none;
+    }
+}
+
+template <typename K, typename V, size_t N, typename Hash>
+constexpr static_hash_map<K, V, N, Hash>::static_hash_map(std::initializer_list<std::pair<K, V>> pairs)
+    : static_hash_map()
+{
+    for (const std::pair<K, V> &pair : pairs)
+    {
+        if (!insert(pair.first, pair.second))
+        {
+            throw std::length_error("static_hash_map initialized with more than N keys");
+        }
+    }
+}
+
+template <typename K, typename V, size_t N, typename Hash>
+constexpr bool static_hash_map<K, V, N, Hash>::insert(K key, V value)
+{
+    size_t *link = _find_link(key);
+
+    // overwrite the value of an existing key
+    if (*link != _none)
+    {
+        _entries[*link].value = value;
+        return true;
+    }
+
+    if (_size == N)
+    {
+        return false;
+    }
+
+    _entries[_size].key = key;
+    _entries[_size].value = value;
+    _entries[_size].next = _none;
+    *link = _size;
+    _size++;
+    return true;
+}
+
+template <typename K, typename V, size_t N, typename Hash>
+constexpr std::optional<V> static_hash_map<K, V, N, Hash>::get_value(K key) const
+{
+    size_t found = _find(key);
+    if (found == _none)
+    {
+        return {};
+    }
+    return _entries[found].value;
+}
+
+template <typename K, typename V, size_t N, typename Hash>
+constexpr bool static_hash_map<K, V, N, Hash>::remove(K key)
+{
+    size_t *link = _find_link(key);
+    if (*link == _none)
+    {
+        return false;
+    }
+
+    size_t removed = *link;
+    *link = _entries[removed].next;
+    _size--;
+
+    // keep the entries packed by moving the last one into the hole
+    if (removed != _size)
+    {
+        size_t *last = _find_link(_entries[_size].key);
+        *last = removed;
+        _entries[removed] = _entries[_size];
+    }
+    _entries[_size] = _entry();
+    return true;
+}
+
+template <typename K, typename V, size_t N, typename Hash>
+constexpr size_t static_hash_map<K, V, N, Hash>::get_size() const
+{
+    return _size;
+}
+
+template <typename K, typename V, size_t N, typename Hash>
+constexpr size_t static_hash_map<K, V, N, Hash>::get_capacity() const
+{
+    return N;
+}
+
+template <typename K, typename V, size_t N, typename Hash>
+constexpr size_t static_hash_map<K, V, N, Hash>::_bucket(const K &key) const
+{
+    return _hash(key) % N;
+}
+
+template <typename K, typename V, size_t N, typename Hash>
+constexpr size_t *static_hash_map<K, V, N, Hash>::_find_link(const K &key)
+{
+    size_t *link = &_buckets[_bucket(key)];
+    while (*link != _none && !(_entries[*link].key == key))
+    {
+        link = &_entries[*link].next;
+    }
+    return link;
+}
+
+template <typename K, typename V, size_t N, typename Hash>
+constexpr size_t static_hash_map<K, V, N, Hash>::_find(const K &key) const
+{
+    size_t current = _buckets[_bucket(key)];
+    while (current != _none && !(_entries[current].key == key))
+    {
+        current = _entries[current].next;
+    }
+    return current;
+}
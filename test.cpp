@@ -8,9 +8,21 @@
 #include <stdlib.h>
 #include <algorithm>
 #include <set>
+#include <atomic>
+#include <chrono>
+#include <sstream>
+#include <thread>
+#include <cmath>
+#include <charconv>
+#include <memory_resource>
+#include <stdint.h>
+#include <string.h>
 
 #include "hash_map.h"
+#include "huge_page_resource.h"
 #include "shared_testing_code.h"
+#include "trace_reader.h"
+#include "binary_trace.h"
 
 /** The initial size of the hash list*/
 #define CAPACITY 500
@@ -238,8 +250,8 @@ bool test_dynamic_capacity(hash_map<K, V> &custom_map,
     {
         if (!custom_map.remove(key))
         {
-            std::cout << "Failed remove on key in test_dynamic_capacity" << std::endl;
-            std::cout << "This means you have an error in your remove function, which is "
+            *diagnostics << "Failed remove on key in test_dynamic_capacity" << std::endl;
+            *diagnostics << "This means you have an error in your remove function, which is "
                       << " unrelated to the dynamic capacity part of the lab."
                       << " You need to fix this error, since it's related to the basic hash map "
                       << " functionality "
@@ -251,7 +263,7 @@ bool test_dynamic_capacity(hash_map<K, V> &custom_map,
     /** Now we should be at minimum capacity */
     if (custom_map.get_capacity() != capacities[0])
     {
-        std::cout << "Empty list doesn't have minimum capacity in test_dynamic_capacity"
+        *diagnostics << "Empty list doesn't have minimum capacity in test_dynamic_capacity"
                   << std::endl;
         return false;
     }
@@ -262,9 +274,9 @@ bool test_dynamic_capacity(hash_map<K, V> &custom_map,
         custom_map.insert(i, i);
     }
 
-    if (custom_map.get_capacity() == capacities[1])
+    if (custom_map.get_capacity() != capacities[1])
     {
-        std::cout << "Capacity isn't correct in test_dynamic_capacity" << std::endl;
+        *diagnostics << "Capacity isn't correct in test_dynamic_capacity" << std::endl;
         return false;
     }
 
@@ -272,8 +284,8 @@ bool test_dynamic_capacity(hash_map<K, V> &custom_map,
     {
         if (!custom_map.remove(i))
         {
-            std::cout << "Failed remove on key in test_dynamic_capacity" << std::endl;
-            std::cout << "This means you have an error in your remove function, which is "
+            *diagnostics << "Failed remove on key in test_dynamic_capacity" << std::endl;
+            *diagnostics << "This means you have an error in your remove function, which is "
                       << " unrelated to the dynamic capacity part of the lab."
                       << " You need to fix this error, since it's related to the basic hash map "
                       << " functionality "
@@ -318,7 +330,7 @@ bool verify_get_all_keys(hash_map<K, V> &custom_map,
 
     if (custom_map_size != ground_truth_map.size())
     {
-        std::cout << Get_all_keys_failed_msg << map_str << " doesn't have expected size" << std::endl;
+        *diagnostics << Get_all_keys_failed_msg << map_str << " doesn't have expected size" << std::endl;
         return false;
     }
 
@@ -331,7 +343,7 @@ bool verify_get_all_keys(hash_map<K, V> &custom_map,
 
     if (key_set.size() != ground_truth_map.size())
     {
-        std::cout << "Wrong number of keys in get_all_keys" << std::endl;
+        *diagnostics << "Wrong number of keys in get_all_keys" << std::endl;
         return false;
     }
 
@@ -339,7 +351,7 @@ bool verify_get_all_keys(hash_map<K, V> &custom_map,
     {
         if (ground_truth_map.count(key) == 0)
         {
-            std::cout << Get_all_keys_failed_msg << map_str
+            *diagnostics << Get_all_keys_failed_msg << map_str
                       << " invalid key " << key << " in map" << std::endl;
             return false;
         }
@@ -360,7 +372,7 @@ bool verify_get_all_sorted_keys(hash_map<K, V> &custom_map,
 
     if (custom_map_size != ground_truth_map.size())
     {
-        std::cout << Get_all_keys_failed_msg << map_str << " doesn't have expected size" << std::endl;
+        *diagnostics << Get_all_keys_failed_msg << map_str << " doesn't have expected size" << std::endl;
         return false;
     }
 
@@ -447,40 +459,26 @@ bool verify_remove_all_values(hash_map<K, V> &custom_map,
 }
 
 /**
- * @brief Inserts the key value pair inside of args into the specified map and map
+ * @brief Inserts the key value pair of an Insert: <key>,<value> line into the specified map and map
  *
  * @param map
  *  The map to insert into
  * @param map
  *  The map to insert into
- * @param args
- *  The string that occurs on the right hand side of Insert: <key>,<value>
+ * @param entry
+ *  The operation read from the trace file
  * @param grading_file
  *  An open file to write errors to
- * @param line_number
- *  The line number of the trace file that this function is being called from
  */
 template <typename K, typename V>
 bool handle_insert(hash_map<K, V> &custom_map,
                    std::unordered_map<K, V> &map,
-                   std::string &args,
-                   std::ofstream &grading_file,
-                   size_t line_number)
+                   const trace_entry<K, V> &entry,
+                   std::ostream &grading_file)
 {
-
-    std::string delimeter = ",";
-    size_t delimeter_pos = args.find(delimeter);
-    K key;
-    V value;
-
-    if (delimeter_pos == std::string::npos)
-    {
-        std::cout << "Failed to find delimeter " << delimeter << " in insert command on line " << line_number << std::endl;
-        return false;
-    }
-
-    key = stoi(args.substr(0, delimeter_pos));
-    value = stof(args.substr(delimeter_pos + 1, std::string::npos));
+    const K &key = entry.key;
+    const V &value = entry.value;
+    size_t line_number = entry.line_number;
 
     map.erase(key);
     map.insert({key, value});
@@ -489,7 +487,7 @@ bool handle_insert(hash_map<K, V> &custom_map,
 
     if (map.size() != custom_map.get_size())
     {
-        std::cout << "Error on line " << line_number << " in trace file: map has size "
+        *diagnostics << "Error on line " << line_number << " in trace file: map has size "
                   << custom_map.get_size() << " but should have size " << map.size() << std::endl;
         return false;
     }
@@ -498,31 +496,29 @@ bool handle_insert(hash_map<K, V> &custom_map,
 }
 
 /**
- * @brief Removes the key inside of args from the specified map and map
+ * @brief Removes the key of a Remove: <key> line from the specified map and map
  *
  * @param map
  *  The map to remove from from
  * @param map
  *  The map to remove from
- * @param args
- *  The string that occurs on the right hand side of Remove: <key>
+ * @param entry
+ *  The operation read from the trace file
  * @param grading_file
  *  An open file to write errors to
- * @param line_number
- *  The line number of the trace file that this function is being called from
  */
 template <typename K, typename V>
 bool handle_remove(hash_map<K, V> &custom_map,
                    std::unordered_map<K, V> &map,
-                   std::string &args,
-                   std::ofstream &grading_file,
-                   size_t line_number)
+                   const trace_entry<K, V> &entry,
+                   std::ostream &grading_file)
 {
-    K key = stoi(args);
+    const K &key = entry.key;
+    size_t line_number = entry.line_number;
 
     if (static_cast<bool>(map.erase(key)) != custom_map.remove(key))
     {
-        std::cout << "Error on line " << line_number << ": Failed to remove key " << key << std::endl;
+        *diagnostics << "Error on line " << line_number << ": Failed to remove key " << key << std::endl;
         return false;
     }
 
@@ -530,28 +526,26 @@ bool handle_remove(hash_map<K, V> &custom_map,
 }
 
 /**
- * @brief Checks that the key specified inside of args in both the map and the map or in neither
+ * @brief Checks that the key of a Get: <key> line is in both the map and the map or in neither
  *
  * @param map
  *  The map to check
  * @param map
  *  The map to check
- * @param args
- *  A string containing the right hand side of Get: <key>
+ * @param entry
+ *  The operation read from the trace file
  * @param grading_file
  *  The grading file to write errors to
- * @param handle_get
- *  The line number of the trace file that this function is being called from
  */
 template <typename K, typename V>
 bool handle_get(hash_map<K, V> &custom_map,
                 std::unordered_map<K, V> &map,
-                std::string &args,
-                std::ofstream &grading_file,
-                size_t line_number)
+                const trace_entry<K, V> &entry,
+                std::ostream &grading_file)
 
 {
-    K key = stoi(args);
+    const K &key = entry.key;
+    size_t line_number = entry.line_number;
 
     std::optional<float> value = custom_map.get_value(key);
     bool map_has_value = static_cast<bool>(map.count(key));
@@ -559,18 +553,18 @@ bool handle_get(hash_map<K, V> &custom_map,
     /** Ensure that both the map and map both have or both don't have the key */
     if (value.has_value() != map_has_value)
     {
-        std::cout << "Error on line:" << line_number << ": ";
+        *diagnostics << "Error on line:" << line_number << ": ";
 
         if (value.has_value())
         {
-            std::cout << "Unexpected key " << key << " found in map";
+            *diagnostics << "Unexpected key " << key << " found in map";
         }
         else
         {
-            std::cout << "Expected key " << key << " in map but it wasn't";
+            *diagnostics << "Expected key " << key << " in map but it wasn't";
         }
 
-        std::cout << std::endl;
+        *diagnostics << std::endl;
 
         return false;
     }
@@ -580,8 +574,8 @@ bool handle_get(hash_map<K, V> &custom_map,
     {
         if (value.value() != map.at(key))
         {
-            std::cout << "Error on line " << line_number << ": ";
-            std::cout << "map has value=" << value.value() << " for key=" << key << " but expected value " << map.at(key) << std::endl;
+            *diagnostics << "Error on line " << line_number << ": ";
+            *diagnostics << "map has value=" << value.value() << " for key=" << key << " but expected value " << map.at(key) << std::endl;
             return false;
         }
     }
@@ -605,7 +599,7 @@ bool handle_get(hash_map<K, V> &custom_map,
 template <typename K, typename V>
 void test_map_functions(hash_map<K, V> &user_map,
                         std::unordered_map<K, V> &map,
-                        std::ofstream &grading_file,
+                        std::ostream &grading_file,
                         const std::string &map_type,
                         test_results &results)
 {
@@ -648,7 +642,7 @@ template <typename K, typename V>
 void test_default_constructed_map(hash_map<K, V> &custom_map,
                                   std::unordered_map<K, V> &map,
                                   bool test_dynamic_size_get_sorted_keys,
-                                  std::ofstream &grading_file,
+                                  std::ostream &grading_file,
                                   test_results &results)
 {
     test_map_functions(custom_map,
@@ -672,7 +666,7 @@ template <typename K, typename V>
 void test_self_assignment(hash_map<K, V> &custom_map,
                           std::unordered_map<K, V> &map,
                           bool test_dynamic_size_sorted_keys,
-                          std::ofstream &grading_file,
+                          std::ostream &grading_file,
                           test_results &results)
 {
     custom_map = custom_map;
@@ -698,7 +692,7 @@ template <typename K, typename V>
 void test_copy_operator_map(hash_map<K, V> &custom_map,
                             std::unordered_map<K, V> &map,
                             bool test_dynamic_size_sorted_keys,
-                            std::ofstream &grading_file,
+                            std::ostream &grading_file,
                             test_results &results)
 {
     hash_map<K, V> copy_map(CAPACITY,
@@ -733,7 +727,7 @@ template <typename K, typename V>
 void test_copy_constructed_map(hash_map<K, V> &custom_map,
                                std::unordered_map<K, V> &map,
                                bool test_dynamic_size_sorted_keys,
-                               std::ofstream &grading_file,
+                               std::ostream &grading_file,
                                test_results &results)
 {
     hash_map<K, V> copy_map(custom_map);
@@ -762,64 +756,558 @@ void test_copy_constructed_map(hash_map<K, V> &custom_map,
 template <typename K, typename V>
 bool run_trace_file(hash_map<K, V> &custom_map,
                     std::unordered_map<K, V> &map,
-                    std::ifstream &input_file,
-                    std::ofstream &grading_file)
+                    trace_reader<K, V> &input_file,
+                    std::ostream &grading_file)
 {
-    std::string current_line;
-    std::string operation_args;
-    size_t idx = 1;
+    trace_entry<K, V> entry;
 
-    idx++;
-
-    while (getline(input_file, current_line))
+    while (input_file.next(entry))
     {
-        std::string operation;
-        std::string delimeter = ":";
-        size_t delimeter_pos = current_line.find(delimeter);
-
-        if (delimeter_pos == std::string::npos)
-        {
-            std::cout << "Error on line " << idx << ", expected delimeter " << delimeter << " in current line but didn't find it" << std::endl;
-            return false;
-        }
-
-        operation = current_line.substr(0, delimeter_pos);
-        operation_args = current_line.substr(delimeter_pos + 1, std::string::npos);
-
-        if (operation == Insert_cmd)
+        if (entry.op == trace_insert)
         {
             if (!handle_insert(custom_map,
                                map,
-                               operation_args,
-                               grading_file,
-                               idx))
+                               entry,
+                               grading_file))
             {
                 return false;
             }
         }
-        else if (operation == Remove_cmd)
+        else if (entry.op == trace_remove)
         {
             if (!handle_remove(custom_map,
                                map,
-                               operation_args,
-                               grading_file,
-                               idx))
+                               entry,
+                               grading_file))
             {
                 return false;
             }
         }
-        else if (operation == Get_cmd)
+        else
         {
             if (!handle_get(custom_map,
                             map,
-                            operation_args,
-                            grading_file,
-                            idx))
+                            entry,
+                            grading_file))
             {
                 return false;
             }
         }
-        idx++;
+    }
+
+    if (input_file.failed())
+    {
+        *diagnostics << "Error on line " << input_file.get_line_number() << ", couldn't parse the operation" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+/** The names benchmark results are reported under, indexed by trace_op */
+const std::string *trace_op_names[trace_op_count] = {&Insert_cmd, &Remove_cmd, &Get_cmd};
+
+/**
+ * Counts latencies in log-linear buckets, 32 to each power of two, so percentiles read back
+ * within about 3% in constant memory however long the trace is
+ */
+class latency_histogram
+{
+
+public:
+    latency_histogram() : _counts(_buckets, 0), _count(0), _total(0), _max(0)
+    {
+    }
+
+    void record(uint64_t nanoseconds)
+    {
+        _counts[_bucket(nanoseconds)]++;
+        _count++;
+        _total += nanoseconds;
+        _max = std::max(_max, nanoseconds);
+    }
+
+    /** Adds in every latency recorded by other */
+    void add(const latency_histogram &other)
+    {
+        for (size_t bucket = 0; bucket < _buckets; bucket++)
+        {
+            _counts[bucket] += other._counts[bucket];
+        }
+        _count += other._count;
+        _total += other._total;
+        _max = std::max(_max, other._max);
+    }
+
+    /** Returns the number of latencies recorded */
+    uint64_t get_count() const
+    {
+        return _count;
+    }
+
+    /** Returns the sum of the latencies recorded */
+    uint64_t get_total() const
+    {
+        return _total;
+    }
+
+    /**
+     * Returns the latency that a fraction p of the recorded ones are at or below, by the
+     * nearest rank method, rounded up to the top of its bucket. Must not be empty
+     */
+    uint64_t percentile(double p) const
+    {
+        uint64_t rank = std::max<uint64_t>(static_cast<uint64_t>(std::ceil(p * _count)), 1);
+        uint64_t seen = 0;
+        size_t bucket = 0;
+        for (; seen + _counts[bucket] < rank; bucket++)
+        {
+            seen += _counts[bucket];
+        }
+        return std::min(_lowest(bucket + 1) - 1, _max);
+    }
+
+private:
+    /** The number of bits below the leading one that pick a bucket */
+    static const int _sub_bits = 5;
+
+    /** Enough buckets for any 64 bit latency */
+    static const size_t _buckets = (64 - _sub_bits + 1) << _sub_bits;
+
+    static size_t _bucket(uint64_t nanoseconds)
+    {
+        if (nanoseconds < (uint64_t(1) << _sub_bits))
+        {
+            return nanoseconds;
+        }
+        int exponent = 63 - __builtin_clzll(nanoseconds);
+        size_t sub = (nanoseconds >> (exponent - _sub_bits)) & ((1 << _sub_bits) - 1);
+        return (size_t(exponent - _sub_bits + 1) << _sub_bits) + sub;
+    }
+
+    /** Returns the smallest latency that falls in bucket */
+    static uint64_t _lowest(size_t bucket)
+    {
+        if (bucket < (size_t(1) << _sub_bits))
+        {
+            return bucket;
+        }
+        int exponent = int(bucket >> _sub_bits) + _sub_bits - 1;
+        uint64_t sub = bucket & ((1 << _sub_bits) - 1);
+        return ((uint64_t(1) << _sub_bits) + sub) << (exponent - _sub_bits);
+    }
+
+    std::vector<uint64_t> _counts;
+    uint64_t _count;
+    uint64_t _total;
+    uint64_t _max;
+};
+
+/** What replaying a trace against one map measured */
+struct replay_results
+{
+    /** The nanoseconds each operation took, by operation type */
+    latency_histogram latencies[trace_op_count];
+
+    size_t operations = 0;
+    size_t get_hits = 0;
+
+    /** The wall clock time of the whole replay, parsing and any checks included */
+    double milliseconds = 0;
+};
+
+/**
+ * @brief Replays every operation of a trace on map, timing each on its own with a monotonic
+ * clock. Operations are streamed from the reader between timed calls and latencies go into
+ * histograms, so memory stays constant whatever the length of the trace
+ *
+ * @param map
+ *  The map to replay on. Anything with hash_map's insert, remove and get_value
+ * @param ground_truth
+ *  If not NULL, every operation is also checked against it, outside the timed region
+ * @return
+ *  False if the trace couldn't be parsed or the map disagreed with the ground truth
+ */
+template <typename K, typename V, typename Map, typename Reader>
+bool replay_timed(Reader &trace_file,
+                  Map &map,
+                  std::unordered_map<K, V> *ground_truth,
+                  replay_results &results)
+{
+    trace_entry<K, V> entry;
+
+    std::chrono::steady_clock::time_point replay_start = std::chrono::steady_clock::now();
+    while (trace_file.next(entry))
+    {
+        bool removed = false;
+        std::optional<V> value;
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        if (entry.op == trace_insert)
+        {
+            map.insert(entry.key, entry.value);
+        }
+        else if (entry.op == trace_remove)
+        {
+            removed = map.remove(entry.key);
+        }
+        else
+        {
+            value = map.get_value(entry.key);
+        }
+        std::chrono::steady_clock::time_point stop = std::chrono::steady_clock::now();
+
+        results.latencies[entry.op].record(std::chrono::duration_cast<std::chrono::nanoseconds>(stop - start).count());
+        results.operations++;
+        results.get_hits += value.has_value();
+
+        if (ground_truth == NULL)
+        {
+            continue;
+        }
+
+        bool agrees;
+        if (entry.op == trace_insert)
+        {
+            (*ground_truth)[entry.key] = entry.value;
+            agrees = ground_truth->size() == map.get_size();
+        }
+        else if (entry.op == trace_remove)
+        {
+            agrees = static_cast<bool>(ground_truth->erase(entry.key)) == removed;
+        }
+        else
+        {
+            auto found = ground_truth->find(entry.key);
+            agrees = found == ground_truth->end() ? !value.has_value() : value == found->second;
+        }
+
+        if (!agrees)
+        {
+            *diagnostics << "Error on line " << entry.line_number << ": " << *trace_op_names[entry.op]
+                      << " of key " << entry.key << " disagrees with std::unordered_map" << std::endl;
+            return false;
+        }
+    }
+    results.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - replay_start).count();
+
+    if (trace_file.failed())
+    {
+        *diagnostics << "Error on line " << trace_file.get_line_number() << ", couldn't parse the operation" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+/** Returns the median cost of two back to back clock reads, to read small latencies against */
+uint64_t clock_overhead()
+{
+    latency_histogram overhead;
+    for (int i = 0; i < 1000; i++)
+    {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        overhead.record(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+    }
+    return overhead.percentile(0.5);
+}
+
+/**
+ * @brief Replays a trace file as a benchmark and writes the throughput and p50/p99/p99.9
+ * latency of each operation type to the grading file.
+ *
+ * Throughput is the operation count over the summed time of the operations themselves, so it
+ * leaves out parsing and the ground truth checks. Those checks still touch a
+ * std::unordered_map between every timed operation though, which evicts the custom map from
+ * the caches, so turn them off for numbers that are comparable between runs.
+ *
+ * @param grading_file
+ *  The file to write results to. Must be open already
+ * @param trace_file
+ *  A trace_reader or binary_trace_reader for the trace to replay. Must be open already
+ * @param check_ground_truth
+ *  True if every operation should be checked against a std::unordered_map
+ * @return
+ *  False if the trace couldn't be parsed or the custom map disagreed with the ground truth
+ */
+template <typename K, typename V, typename Reader>
+bool benchmark_trace_file(std::ostream &grading_file,
+                          Reader &trace_file,
+                          bool check_ground_truth)
+{
+    hash_map<K, V> custom_map(CAPACITY,
+                              UPPER_LOAD_FACTOR,
+                              LOWER_LOAD_FACTOR);
+
+    std::unordered_map<K, V> map;
+
+    replay_results results;
+
+    if (!replay_timed(trace_file, custom_map, check_ground_truth ? &map : NULL, results))
+    {
+        return false;
+    }
+
+    grading_file << "Benchmark: " << results.operations << " operations replayed in " << results.milliseconds << " ms, "
+                 << results.get_hits << " get hits, ground truth checks "
+                 << (check_ground_truth ? "on" : "off") << ", clock overhead " << clock_overhead()
+                 << " ns" << std::endl;
+
+    uint64_t total_nanoseconds = 0;
+    for (size_t op = 0; op < trace_op_count; op++)
+    {
+        const latency_histogram &histogram = results.latencies[op];
+
+        if (histogram.get_count() == 0)
+        {
+            continue;
+        }
+
+        total_nanoseconds += histogram.get_total();
+
+        grading_file << *trace_op_names[op] << ": " << histogram.get_count() << " ops, "
+                     << histogram.get_count() * 1e9 / std::max<uint64_t>(histogram.get_total(), 1) << " ops/s, p50 "
+                     << histogram.percentile(0.5) << " ns, p99 "
+                     << histogram.percentile(0.99) << " ns, p99.9 "
+                     << histogram.percentile(0.999) << " ns" << std::endl;
+    }
+
+    grading_file << "Total: " << results.operations * 1e9 / std::max<uint64_t>(total_nanoseconds, 1)
+                 << " ops/s" << std::endl;
+
+    return true;
+}
+
+/**
+ * Forwards to another resource and counts the bytes allocated through it, now and at most,
+ * so engines can be compared by the memory they ask for. The counters are atomic since a
+ * background rehash allocates from its own thread
+ */
+class counting_resource : public std::pmr::memory_resource
+{
+
+public:
+    explicit counting_resource(std::pmr::memory_resource *upstream = std::pmr::new_delete_resource())
+        : _upstream(upstream), _bytes(0), _peak(0)
+    {
+    }
+
+    /** Returns the bytes allocated and not yet freed */
+    size_t get_bytes() const
+    {
+        return _bytes;
+    }
+
+    /** Returns the most bytes there have been allocated at once */
+    size_t get_peak() const
+    {
+        return _peak;
+    }
+
+protected:
+    void *do_allocate(size_t size, size_t alignment) override
+    {
+        size_t bytes = _bytes += size;
+        size_t peak = _peak;
+        while (bytes > peak && !_peak.compare_exchange_weak(peak, bytes))
+        {
+        }
+        return _upstream->allocate(size, alignment);
+    }
+
+    void do_deallocate(void *p, size_t size, size_t alignment) override
+    {
+        _bytes -= size;
+        _upstream->deallocate(p, size, alignment);
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override
+    {
+        return this == &other;
+    }
+
+private:
+    std::pmr::memory_resource *_upstream;
+    std::atomic<size_t> _bytes;
+    std::atomic<size_t> _peak;
+};
+
+/** Gives a std::pmr::unordered_map the calls replay_timed makes on hash_map */
+template <typename K, typename V>
+class unordered_map_engine
+{
+
+public:
+    explicit unordered_map_engine(std::pmr::memory_resource *resource) : _map(resource)
+    {
+    }
+
+    void insert(const K &key, const V &value)
+    {
+        _map.insert_or_assign(key, value);
+    }
+
+    bool remove(const K &key)
+    {
+        return _map.erase(key) != 0;
+    }
+
+    std::optional<V> get_value(const K &key) const
+    {
+        auto found = _map.find(key);
+        if (found == _map.end())
+        {
+            return std::nullopt;
+        }
+        return found->second;
+    }
+
+    size_t get_size() const
+    {
+        return _map.size();
+    }
+
+private:
+    std::pmr::unordered_map<K, V> _map;
+};
+
+/** What comparing one engine on a trace measured */
+struct engine_results
+{
+    std::string name;
+    replay_results replay;
+
+    /** The latencies of every operation type together */
+    latency_histogram latencies;
+
+    size_t final_size = 0;
+    size_t final_bytes = 0;
+    size_t peak_bytes = 0;
+};
+
+/**
+ * @brief Replays the trace on map, which allocates through memory, and records how it did
+ *
+ * @return
+ *  False if the trace couldn't be parsed
+ */
+template <typename K, typename V, typename Map, typename Reader>
+bool compare_engine(const char *name,
+                    Reader &trace_file,
+                    Map &map,
+                    const counting_resource &memory,
+                    std::vector<engine_results> &engines)
+{
+    engines.emplace_back();
+    engine_results &engine = engines.back();
+    engine.name = name;
+
+    trace_file.rewind();
+    if (!replay_timed<K, V>(trace_file, map, NULL, engine.replay))
+    {
+        return false;
+    }
+
+    for (const latency_histogram &histogram : engine.replay.latencies)
+    {
+        engine.latencies.add(histogram);
+    }
+    engine.final_size = map.get_size();
+    engine.final_bytes = memory.get_bytes();
+    engine.peak_bytes = memory.get_peak();
+    return true;
+}
+
+/**
+ * @brief Replays a trace file against hash_map in its main configurations and against
+ * std::unordered_map, one after another on the same operations, and writes a table of each
+ * one's throughput, latency percentiles over every operation, peak memory and bytes per entry
+ * left at the end to the grading file.
+ *
+ * Memory is what each container asks its memory resource for, so it leaves out allocator
+ * overhead and, for the huge page engine, the unused rest of each page. Ground truth checks are off; instead the
+ * engines must agree on the number of get hits and the final size.
+ *
+ * frozen_hash_map can't take inserts and static_hash_map has its capacity fixed at compile
+ * time, so neither can replay an arbitrary trace and they aren't compared.
+ *
+ * @return
+ *  False if the trace couldn't be parsed or the engines disagreed
+ */
+template <typename K, typename V, typename Reader>
+bool compare_engines_on_trace(std::ostream &grading_file,
+                              Reader &trace_file)
+{
+    std::vector<engine_results> engines;
+    bool replayed;
+
+    {
+        counting_resource memory;
+        hash_map<K, V> map(CAPACITY, UPPER_LOAD_FACTOR, LOWER_LOAD_FACTOR, &memory);
+        replayed = compare_engine<K, V>("hash_map", trace_file, map, memory, engines);
+    }
+
+    if (replayed)
+    {
+        counting_resource memory;
+        hash_map<K, V> map(CAPACITY, UPPER_LOAD_FACTOR, LOWER_LOAD_FACTOR, &memory);
+        map.set_bucket_policy(bucket_policy::transpose);
+        replayed = compare_engine<K, V>("hash_map, transpose", trace_file, map, memory, engines);
+    }
+
+#ifndef HASH_MAP_BACKGROUND_REHASH
+    // the pool isn't thread safe, and a background rehash would allocate from it on its own thread
+    if (replayed)
+    {
+        huge_page_resource pages;
+        std::pmr::unsynchronized_pool_resource pool(&pages);
+        counting_resource memory(&pool);
+        hash_map<K, V> map(CAPACITY, UPPER_LOAD_FACTOR, LOWER_LOAD_FACTOR, &memory);
+        replayed = compare_engine<K, V>("hash_map, huge pages", trace_file, map, memory, engines);
+    }
+#endif
+
+    if (replayed)
+    {
+        counting_resource memory;
+        unordered_map_engine<K, V> map(&memory);
+        replayed = compare_engine<K, V>("std::unordered_map", trace_file, map, memory, engines);
+    }
+
+    if (!replayed)
+    {
+        return false;
+    }
+
+    const engine_results &baseline = engines.back();
+    for (const engine_results &engine : engines)
+    {
+        if (engine.replay.get_hits != baseline.replay.get_hits || engine.final_size != baseline.final_size)
+        {
+            *diagnostics << engine.name << " ends with " << engine.final_size << " entries and "
+                         << engine.replay.get_hits << " get hits, but " << baseline.name << " with "
+                         << baseline.final_size << " and " << baseline.replay.get_hits << std::endl;
+            return false;
+        }
+    }
+
+    grading_file << "Engine comparison: " << baseline.replay.operations << " operations, "
+                 << baseline.replay.get_hits << " get hits, " << baseline.final_size
+                 << " entries at the end, clock overhead " << clock_overhead() << " ns" << std::endl;
+
+    double baseline_throughput = baseline.latencies.get_count() * 1e9 / std::max<uint64_t>(baseline.latencies.get_total(), 1);
+    for (const engine_results &engine : engines)
+    {
+        double throughput = engine.latencies.get_count() * 1e9 / std::max<uint64_t>(engine.latencies.get_total(), 1);
+
+        grading_file << engine.name << ": " << throughput << " ops/s ("
+                     << throughput / baseline_throughput << "x " << baseline.name << "), p50 "
+                     << engine.latencies.percentile(0.5) << " ns, p99 "
+                     << engine.latencies.percentile(0.99) << " ns, p99.9 "
+                     << engine.latencies.percentile(0.999) << " ns, peak "
+                     << engine.peak_bytes << " bytes, "
+                     << engine.final_bytes / static_cast<double>(std::max<size_t>(engine.final_size, 1))
+                     << " bytes/entry" << std::endl;
     }
 
     return true;
@@ -845,8 +1333,8 @@ bool run_trace_file(hash_map<K, V> &custom_map,
  */
 template <typename K, typename V>
 std::tuple<test_results, test_results, test_results, test_results>
-test_trace_file(std::ofstream &grading_file,
-                std::ifstream &trace_file,
+test_trace_file(std::ostream &grading_file,
+                trace_reader<K, V> &trace_file,
                 bool test_copy_constructor,
                 bool test_assignment_operator,
                 bool test_dynamic_size_sorted_keys,
@@ -935,10 +1423,15 @@ test_trace_file(std::ofstream &grading_file,
  *  The tuple fields, from left to right, correspond to
  *      flag indicating if copy constructor should be tested
  *      flag indicating if iterator should be tested
+ *      flag indicating if dynamic size and sorted keys should be tested
+ *      flag indicating if the traces should be benchmarked instead of graded
+ *      flag indicating if benchmarks should check results against std::unordered_map
+ *      flag indicating if benchmarks should compare every storage engine
+ *      number of threads to replay trace files on
  *      name of the grading file
  *      vector of names of the trace files
  */
-std::tuple<bool, bool, bool, std::string, std::vector<std::string>>
+std::tuple<bool, bool, bool, bool, bool, bool, size_t, std::string, std::vector<std::string>>
 parse_cmd_line_inputs(int argc,
                       char **argv)
 {
@@ -947,10 +1440,14 @@ parse_cmd_line_inputs(int argc,
     bool test_copy_constructor = false;
     bool test_assignment = false;
     bool test_dynamic_size_sorted_keys = false;
+    bool benchmark = false;
+    bool check_ground_truth = true;
+    bool compare_engines = false;
+    size_t jobs = 1;
     std::string grading_file;
     std::vector<std::string> trace_files;
 
-    while ((option = getopt(argc, argv, "cad")) != -1)
+    while ((option = getopt(argc, argv, "cadbnej:")) != -1)
     {
         switch (option)
         {
@@ -963,6 +1460,31 @@ parse_cmd_line_inputs(int argc,
         case 'd':
             test_dynamic_size_sorted_keys = true;
             break;
+        case 'b':
+            benchmark = true;
+            break;
+        case 'n':
+            check_ground_truth = false;
+            break;
+        case 'e':
+            benchmark = true;
+            compare_engines = true;
+            break;
+        case 'j':
+        {
+            const char *end = optarg + strlen(optarg);
+            std::from_chars_result parsed = std::from_chars(optarg, end, jobs);
+            if (parsed.ec != std::errc() || parsed.ptr != end)
+            {
+                std::cout << "Error occurred when parsing option" << std::endl;
+                exit(1);
+            }
+            if (jobs == 0)
+            {
+                jobs = std::max(std::thread::hardware_concurrency(), 1u);
+            }
+            break;
+        }
         default:
             std::cout << "Error occurred when parsing option" << std::endl;
             exit(1);
@@ -985,10 +1507,193 @@ parse_cmd_line_inputs(int argc,
     return std::make_tuple(test_copy_constructor,
                            test_assignment,
                            test_dynamic_size_sorted_keys,
+                           benchmark,
+                           check_ground_truth,
+                           compare_engines,
+                           jobs,
                            grading_file,
                            trace_files);
 }
 
+/**
+ * @brief Replays one trace file, grading it or benchmarking it, and writes its results to
+ * grading_file. Everything it uses is its own, so several can run at once
+ *
+ * @param trace_file_name
+ *  The trace file to replay
+ * @param grading_file
+ *  Where the results go
+ */
+void replay_trace_file(const std::string &trace_file_name,
+                       bool test_copy_constructor,
+                       bool test_assignment,
+                       bool test_dynamic_size_get_sorted_keys,
+                       bool benchmark,
+                       bool check_ground_truth,
+                       bool compare_engines,
+                       std::ostream &grading_file)
+{
+    /** Holds input traces, for reading their point values */
+    std::ifstream trace_file;
+
+    binary_trace_header header;
+
+    if (read_binary_trace_header(trace_file_name.c_str(), header))
+    {
+        /** Streams the records of a binary trace */
+        binary_trace_reader<int, float> records(trace_file_name.c_str());
+
+        if (!records.is_open())
+        {
+            grading_file << trace_file_name << ": binary trace doesn't hold int keys and float values" << std::endl;
+            return;
+        }
+
+        grading_file << "Trace file: " << trace_file_name << std::endl;
+
+        if (!benchmark)
+        {
+            grading_file << "Binary traces have no point values, so they can only be benchmarked with -b" << std::endl;
+        }
+        else if (compare_engines ? !compare_engines_on_trace<int, float>(grading_file, records)
+                                 : !benchmark_trace_file<int, float>(grading_file,
+                                                                     records,
+                                                                     check_ground_truth))
+        {
+            grading_file << "Benchmark failed" << std::endl;
+        }
+
+        return;
+    }
+
+    /** Reads the operations out of the trace */
+    trace_reader<int, float> operations(trace_file_name.c_str());
+
+    if (!operations.is_open())
+    {
+        grading_file << trace_file_name << ": failed to open trace file" << std::endl;
+        return;
+    }
+
+    grading_file << "Trace file: " << trace_file_name << std::endl;
+
+    if (benchmark)
+    {
+        if (compare_engines ? !compare_engines_on_trace<int, float>(grading_file, operations)
+                            : !benchmark_trace_file<int, float>(grading_file,
+                                                                operations,
+                                                                check_ground_truth))
+        {
+            grading_file << "Benchmark failed" << std::endl;
+        }
+
+        return;
+    }
+
+    trace_file.open(trace_file_name);
+    auto [results, multipliers] = parse_trace_file_points(trace_file);
+    trace_file.close();
+
+    auto [default_map_results,
+          copy_map_results,
+          assignment_map_results,
+          self_assignment_map_results] = test_trace_file<int, float>(grading_file,
+                                                                     operations,
+                                                                     test_copy_constructor,
+                                                                     test_assignment,
+                                                                     test_dynamic_size_get_sorted_keys,
+                                                                     results);
+
+    default_map_results.multiplier = multipliers.default_constructor_multiplier;
+    copy_map_results.multiplier = multipliers.copy_constructor_multiplier;
+    assignment_map_results.multiplier = multipliers.assignment_operator_multiplier;
+    self_assignment_map_results.multiplier = multipliers.self_assignment_multiplier;
+
+    /**
+     * If we're not testing dynamic capacity/get_sorted_keys we need to zero out the
+     * scores here
+     */
+    if (!test_dynamic_size_get_sorted_keys)
+    {
+        default_map_results.dynamic_size.second = 0;
+        default_map_results.get_all_sorted_keys.second = 0;
+        copy_map_results.dynamic_size.second = 0;
+        copy_map_results.get_all_sorted_keys.second = 0;
+        self_assignment_map_results.dynamic_size.second = 0;
+        self_assignment_map_results.get_all_sorted_keys.second = 0;
+        assignment_map_results.dynamic_size.second = 0;
+        assignment_map_results.get_all_sorted_keys.second = 0;
+    }
+
+    write_test_results_to_file(default_map_results,
+                               copy_map_results,
+                               assignment_map_results,
+                               self_assignment_map_results,
+                               test_copy_constructor,
+                               test_assignment,
+                               test_dynamic_size_get_sorted_keys,
+                               grading_file);
+}
+
+/**
+ * @brief Replays trace files on a pool of threads, each trace with its own hash_map and
+ * std::unordered_map. Every trace's grading results and diagnostics are buffered and written
+ * out in the order the files were given, so the output matches a run on one thread apart from
+ * benchmark timings, which are measured with the other threads competing for the machine
+ *
+ * @param jobs
+ *  The number of threads, including this one
+ */
+void replay_trace_files_in_parallel(const std::vector<std::string> &trace_file_names,
+                                    size_t jobs,
+                                    bool test_copy_constructor,
+                                    bool test_assignment,
+                                    bool test_dynamic_size_get_sorted_keys,
+                                    bool benchmark,
+                                    bool check_ground_truth,
+                                    bool compare_engines,
+                                    std::ostream &grading_file)
+{
+    std::vector<std::ostringstream> results(trace_file_names.size());
+    std::vector<std::ostringstream> messages(trace_file_names.size());
+
+    /** The next trace for a thread to take */
+    std::atomic<size_t> next_trace(0);
+
+    auto replay_traces = [&]() {
+        for (size_t index = next_trace++; index < trace_file_names.size(); index = next_trace++)
+        {
+            diagnostics = &messages[index];
+            replay_trace_file(trace_file_names[index],
+                              test_copy_constructor,
+                              test_assignment,
+                              test_dynamic_size_get_sorted_keys,
+                              benchmark,
+                              check_ground_truth,
+                              compare_engines,
+                              results[index]);
+        }
+        diagnostics = &std::cout;
+    };
+
+    std::vector<std::thread> workers;
+    for (size_t t = 1; t < std::min(jobs, trace_file_names.size()); t++)
+    {
+        workers.emplace_back(replay_traces);
+    }
+    replay_traces();
+    for (std::thread &worker : workers)
+    {
+        worker.join();
+    }
+
+    for (size_t index = 0; index < trace_file_names.size(); index++)
+    {
+        std::cout << messages[index].str();
+        grading_file << results[index].str();
+    }
+}
+
 /**
  * @brief
  * To run this program you must invoke it as
@@ -996,18 +1701,31 @@ parse_cmd_line_inputs(int argc,
  *          APP_NAME <grading file name> <any number of trace files>
  *
  * The test_copy flag is optional. If the flag is true then the copy constructor and = operator are tested
+ *
+ * With -b each trace file is replayed as a benchmark instead, and the latency and throughput of
+ * every operation type is written to the grading file. Adding -n turns off checking each
+ * operation against std::unordered_map during the benchmark. Trace files in the binary format
+ * written by tools/trace_convert are recognized by their header and can only be benchmarked.
+ *
+ * With -e each trace file is replayed against every storage engine in turn, hash_map in its
+ * main configurations and std::unordered_map, and their throughput, latency and memory are
+ * written side by side.
+ *
+ * With -j <threads> the trace files are replayed in parallel, and -j 0 uses every core. The
+ * grading file comes out in the same order either way
  */
 int main(int argc, char **argv)
 {
     /** Stores grading results */
     std::ofstream grading_file;
 
-    /** Holds input traces */
-    std::ifstream trace_file;
-
     auto [test_copy_constructor,
           test_assignment,
           test_dynamic_size_get_sorted_keys,
+          benchmark,
+          check_ground_truth,
+          compare_engines,
+          jobs,
           grading_file_name,
           trace_file_names] = parse_cmd_line_inputs(argc, argv);
 
@@ -1019,65 +1737,31 @@ int main(int argc, char **argv)
         exit(1);
     }
 
-    for (std::string &cur_trace_file_name : trace_file_names)
+    if (jobs > 1)
     {
-        trace_file.open(cur_trace_file_name);
-
-        if (!trace_file.is_open())
-        {
-            grading_file << cur_trace_file_name << ": failed to open trace file" << std::endl;
-            continue;
-        }
-
-        grading_file << "Trace file: " << cur_trace_file_name << std::endl;
-
-        auto [results, multipliers] = parse_trace_file_points(trace_file);
-
-        /** Reset file pointer back to the beginning */
-        trace_file.clear();
-        trace_file.seekg(0, std::ios::beg);
-
-        auto [default_map_results,
-              copy_map_results,
-              assignment_map_results,
-              self_assignment_map_results] = test_trace_file<int, float>(grading_file,
-                                                                         trace_file,
-                                                                         test_copy_constructor,
-                                                                         test_assignment,
-                                                                         test_dynamic_size_get_sorted_keys,
-                                                                         results);
-
-        default_map_results.multiplier = multipliers.default_constructor_multiplier;
-        copy_map_results.multiplier = multipliers.copy_constructor_multiplier;
-        assignment_map_results.multiplier = multipliers.assignment_operator_multiplier;
-        self_assignment_map_results.multiplier = multipliers.self_assignment_multiplier;
-
-        /**
-         * If we're not testing dynamic capacity/get_sorted_keys we need to zero out the
-         * scores here
-         */
-        if (!test_dynamic_size_get_sorted_keys)
+        replay_trace_files_in_parallel(trace_file_names,
+                                       jobs,
+                                       test_copy_constructor,
+                                       test_assignment,
+                                       test_dynamic_size_get_sorted_keys,
+                                       benchmark,
+                                       check_ground_truth,
+                                       compare_engines,
+                                       grading_file);
+    }
+    else
+    {
+        for (std::string &cur_trace_file_name : trace_file_names)
         {
-            default_map_results.dynamic_size.second = 0;
-            default_map_results.get_all_sorted_keys.second = 0;
-            copy_map_results.dynamic_size.second = 0;
-            copy_map_results.get_all_sorted_keys.second = 0;
-            self_assignment_map_results.dynamic_size.second = 0;
-            self_assignment_map_results.get_all_sorted_keys.second = 0;
-            assignment_map_results.dynamic_size.second = 0;
-            assignment_map_results.get_all_sorted_keys.second = 0;
+            replay_trace_file(cur_trace_file_name,
+                              test_copy_constructor,
+                              test_assignment,
+                              test_dynamic_size_get_sorted_keys,
+                              benchmark,
+                              check_ground_truth,
+                              compare_engines,
+                              grading_file);
         }
-
-        trace_file.close();
-
-        write_test_results_to_file(default_map_results,
-                                   copy_map_results,
-                                   assignment_map_results,
-                                   self_assignment_map_results,
-                                   test_copy_constructor,
-                                   test_assignment,
-                                   test_dynamic_size_get_sorted_keys,
-                                   grading_file);
     }
 
     grading_file.close();
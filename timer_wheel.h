@@ -0,0 +1,92 @@
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "hash_list.h"
+
+/**
+ * A hierarchical timer wheel over the nodes of a hash_map compiled with HASH_MAP_TTL.
+ * Each node is linked into exactly one slot through its intrusive timer_next/timer_pprev
+ * fields, so scheduling and cancelling never allocate and are O(1). Level n has
+ * `slots` slots, each covering slots^n ticks. A node is placed on the lowest level whose
+ * range covers its expiry and drops down a level whenever the wheel reaches its slot, so
+ * each node is touched at most `levels` times before it expires.
+ */
+template <typename K, typename V>
+class timer_wheel
+{
+
+public:
+    /** log2 of the number of slots per level */
+    static constexpr size_t slot_bits = 6;
+
+    /** The number of slots per level */
+    static constexpr size_t slots = size_t(1) << slot_bits;
+
+    /** The number of levels. Expiries further out than slots^levels ticks are re-checked */
+    static constexpr size_t levels = 4;
+
+    /** Create an empty wheel */
+    timer_wheel();
+
+    /**
+     * Link timer into the slot for its expires_at tick. An expiry the wheel has already
+     * moved past fires on the next call to advance. now is only used to fast forward an
+     * empty wheel
+     */
+    void schedule(node<K, V> *timer, uint64_t now);
+
+    /** Unlink timer from its slot. Does nothing if it isn't scheduled */
+    void cancel(node<K, V> *timer);
+
+    /**
+     * Move the wheel forward to now, unlinking every node whose expires_at is at or before
+     * now and passing it to expire. Stops early once max_batch nodes expired, and the next
+     * call picks up where this one stopped.
+     *
+     * @return the number of nodes passed to expire
+     */
+    template <typename Expire>
+    size_t advance(uint64_t now, size_t max_batch, Expire expire);
+
+    /** Forget every scheduled node without touching the nodes themselves */
+    void clear();
+
+    /** Return the number of scheduled nodes */
+    size_t get_size() const;
+
+private:
+    /** Link timer into the slot that matches its expiry relative to _current */
+    void _place(node<K, V> *timer);
+
+    /** Link timer in at the front of the slot list starting at head */
+    static void _push(node<K, V> **head, node<K, V> *timer);
+
+    /** Drop the nodes in every higher level slot that _current just reached one level down */
+    void _cascade();
+
+    /** The heads of the slot lists, indexed by level then slot */
+    node<K, V> *_slots[levels][slots];
+
+    /** Nodes whose expiry had already been processed by the time they were scheduled */
+    node<K, V> *_overdue;
+
+    /** Bit n of _occupied[level] is set if slot n of that level may hold nodes */
+    uint64_t _occupied[levels];
+
+    /** The next tick to process. Every tick before it has been processed */
+    uint64_t _current;
+
+    /** True once the higher levels have been cascaded for _current */
+    bool _cascaded;
+
+    /** The number of scheduled nodes */
+    size_t _count;
+};
+
+/** See hash_list.h for an explanation of why this odd line of code is here */
+#include "timer_wheel.hpp"
+
+#endif
@@ -0,0 +1,187 @@
+#include "timer_wheel.h"
+
+#include <algorithm>
+
+template <typename K, typename V>
+timer_wheel<K, V>::timer_wheel()
+{
+    clear();
+    _current = 0;
+}
+
+template <typename K, typename V>
+void timer_wheel<K, V>::schedule(node<K, V> *timer, uint64_t now)
+{
+    // nothing is waiting, so there's no reason to step through the idle ticks later
+    if (_count == 0 && now > _current)
+    {
+        _current = now;
+        _cascaded = false;
+    }
+    _place(timer);
+    _count++;
+}
+
+template <typename K, typename V>
+void timer_wheel<K, V>::cancel(node<K, V> *timer)
+{
+    if (timer->timer_pprev == NULL)
+    {
+        return;
+    }
+    *timer->timer_pprev = timer->timer_next;
+    if (timer->timer_next != NULL)
+    {
+        timer->timer_next->timer_pprev = timer->timer_pprev;
+    }
+    timer->timer_next = NULL;
+    timer->timer_pprev = NULL;
+    _count--;
+}
+
+template <typename K, typename V>
+template <typename Expire>
+size_t timer_wheel<K, V>::advance(uint64_t now, size_t max_batch, Expire expire)
+{
+    size_t expired = 0;
+
+    while (node<K, V> *timer = _overdue)
+    {
+        if (expired == max_batch)
+        {
+            return expired;
+        }
+        cancel(timer);
+        expire(timer);
+        expired++;
+    }
+
+    while (_current <= now)
+    {
+        if (_count == 0)
+        {
+            _current = now + 1;
+            _cascaded = false;
+            break;
+        }
+
+        if (!_cascaded)
+        {
+            _cascade();
+            _cascaded = true;
+        }
+
+        // every node in this slot expires exactly at _current
+        size_t slot = _current & (slots - 1);
+        while (node<K, V> *timer = _slots[0][slot])
+        {
+            if (expired == max_batch)
+            {
+                return expired;
+            }
+            cancel(timer);
+            expire(timer);
+            expired++;
+        }
+        _occupied[0] &= ~(uint64_t(1) << slot);
+
+        // skip the empty slots up to the next occupied one or the next cascade, whichever is first
+        uint64_t next = (_current | (slots - 1)) + 1;
+        uint64_t later = slot + 1 < slots ? _occupied[0] >> (slot + 1) : 0;
+        if (later != 0)
+        {
+            next = _current + 1 + __builtin_ctzll(later);
+        }
+        _current = std::min(next, now + 1);
+        _cascaded = false;
+    }
+
+    return expired;
+}
+
+template <typename K, typename V>
+void timer_wheel<K, V>::clear()
+{
+    std::fill(&_slots[0][0], &_slots[0][0] + levels * slots, (node<K, V> *)NULL);
+    std::fill(_occupied, _occupied + levels, 0);
+    _overdue = NULL;
+    _cascaded = false;
+    _count = 0;
+}
+
+template <typename K, typename V>
+size_t timer_wheel<K, V>::get_size() const
+{
+    return _count;
+}
+
+template <typename K, typename V>
+void timer_wheel<K, V>::_place(node<K, V> *timer)
+{
+    uint64_t when = timer->expires_at;
+
+    // the wheel has already moved past this tick, so it goes straight to the next advance
+    if (when < _current)
+    {
+        _push(&_overdue, timer);
+        return;
+    }
+
+    uint64_t delta = when - _current;
+    size_t level = 0;
+
+    while (level + 1 < levels && delta >= (uint64_t(1) << (slot_bits * (level + 1))))
+    {
+        level++;
+    }
+
+    // too far out for the top level, so park it at the far end and re-check when it comes around
+    if (delta >= (uint64_t(1) << (slot_bits * levels)))
+    {
+        when = _current + (uint64_t(1) << (slot_bits * levels)) - 1;
+    }
+
+    size_t slot = (when >> (slot_bits * level)) & (slots - 1);
+    _push(&_slots[level][slot], timer);
+    _occupied[level] |= uint64_t(1) << slot;
+}
+
+template <typename K, typename V>
+void timer_wheel<K, V>::_push(node<K, V> **head, node<K, V> *timer)
+{
+    timer->timer_next = *head;
+    timer->timer_pprev = head;
+    if (*head != NULL)
+    {
+        (*head)->timer_pprev = &timer->timer_next;
+    }
+    *head = timer;
+}
+
+template <typename K, typename V>
+void timer_wheel<K, V>::_cascade()
+{
+    // find the highest level whose slot boundary _current sits on
+    size_t top = 0;
+    while (top + 1 < levels && (_current & ((uint64_t(1) << (slot_bits * (top + 1))) - 1)) == 0)
+    {
+        top++;
+    }
+
+    // cascade from the top down so nodes can fall through several levels at once
+    for (size_t level = top; level > 0; level--)
+    {
+        size_t slot = (_current >> (slot_bits * level)) & (slots - 1);
+        node<K, V> *timer = _slots[level][slot];
+
+        _slots[level][slot] = NULL;
+        _occupied[level] &= ~(uint64_t(1) << slot);
+
+        while (timer != NULL)
+        {
+            node<K, V> *next = timer->timer_next;
+            _place(timer);
+            timer = next;
+        }
+    }
+}
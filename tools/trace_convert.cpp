@@ -0,0 +1,207 @@
+/**
+ * Converts traces between the "Insert: k,v" / "Get: k" / "Remove: k" text format and the
+ * binary format of binary_trace.h. The direction comes from the input: a file starting with
+ * a binary trace header is written out as text, anything else is read as text.
+ *
+ * Usage: trace_convert [-k type] [-v type] <input> <output>
+ *
+ *  -k type   Key type for text to binary: int32, uint32, int64 or uint64 (default int32)
+ *  -v type   Value type for text to binary: any key type, float or double (default float)
+ *
+ * The defaults are the int keys and float values test replays. Binary to text uses the
+ * types in the header. Output "-" is standard output.
+ */
+#include <charconv>
+#include <iostream>
+#include <string>
+#include <type_traits>
+#include <getopt.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "binary_trace.h"
+#include "trace_reader.h"
+
+/** The names -k and -v take, indexed by binary_trace_type */
+static const char *type_names[] = {NULL, "int32", "uint32", "int64", "uint64", "float", "double"};
+
+/** Writes number in the form the text format uses, returning the end of what was written */
+template <typename T>
+static char *write_number(char *first, char *last, T number)
+{
+    // fixed, so whole values come out like the generator writes them rather than as 3e+05
+    if constexpr (std::is_floating_point_v<T>)
+    {
+        return std::to_chars(first, last, number, std::chars_format::fixed).ptr;
+    }
+    else
+    {
+        return std::to_chars(first, last, number).ptr;
+    }
+}
+
+/** Calls f with a value of the type a binary_trace_type stands for */
+template <typename F>
+static void with_type(uint8_t type, F f)
+{
+    switch (type)
+    {
+    case binary_trace_int32:
+        f(int32_t());
+        break;
+    case binary_trace_uint32:
+        f(uint32_t());
+        break;
+    case binary_trace_int64:
+        f(int64_t());
+        break;
+    case binary_trace_uint64:
+        f(uint64_t());
+        break;
+    case binary_trace_float:
+        f(float());
+        break;
+    default:
+        f(double());
+        break;
+    }
+}
+
+static uint8_t parse_type(const char *name)
+{
+    for (uint8_t type = binary_trace_int32; type <= binary_trace_double; type++)
+    {
+        if (strcmp(name, type_names[type]) == 0)
+        {
+            return type;
+        }
+    }
+    std::cerr << "trace_convert: unknown type " << name << std::endl;
+    exit(1);
+}
+
+template <typename K, typename V>
+static bool text_to_binary(const char *input, FILE *output)
+{
+    trace_reader<K, V> reader(input);
+    if (!reader.is_open())
+    {
+        std::cerr << "trace_convert: can't read " << input << std::endl;
+        return false;
+    }
+
+    binary_trace_writer<K, V> writer(output);
+    trace_entry<K, V> entry;
+    while (reader.next(entry))
+    {
+        writer.write(entry);
+    }
+    if (reader.failed())
+    {
+        std::cerr << "trace_convert: can't parse line " << reader.get_line_number() << " of " << input << std::endl;
+        return false;
+    }
+    return writer.finish();
+}
+
+template <typename K, typename V>
+static bool binary_to_text(const char *input, FILE *output)
+{
+    binary_trace_reader<K, V> reader(input);
+    if (!reader.is_open())
+    {
+        std::cerr << "trace_convert: can't read " << input << std::endl;
+        return false;
+    }
+
+    static const char *commands[trace_op_count] = {"Insert: ", "Remove: ", "Get: "};
+    // a double written in fixed notation can take over 300 digits
+    char line[512];
+    trace_entry<K, V> entry;
+    bool written = true;
+    while (written && reader.next(entry))
+    {
+        size_t length = strlen(commands[entry.op]);
+        memcpy(line, commands[entry.op], length);
+        char *end = write_number(line + length, line + sizeof(line), entry.key);
+        if (entry.op == trace_insert)
+        {
+            *end++ = ',';
+            end = write_number(end, line + sizeof(line), entry.value);
+        }
+        *end++ = '\n';
+        written = fwrite(line, 1, end - line, output) == size_t(end - line);
+    }
+    if (reader.failed())
+    {
+        std::cerr << "trace_convert: record " << reader.get_line_number() << " of " << input << " is corrupt" << std::endl;
+        return false;
+    }
+    return written && fflush(output) == 0;
+}
+
+int main(int argc, char **argv)
+{
+    uint8_t key_type = binary_trace_int32;
+    uint8_t value_type = binary_trace_float;
+    int option;
+
+    while ((option = getopt(argc, argv, "k:v:")) != -1)
+    {
+        switch (option)
+        {
+        case 'k':
+            key_type = parse_type(optarg);
+            if (key_type >= binary_trace_float)
+            {
+                std::cerr << "trace_convert: keys must be integers" << std::endl;
+                return 1;
+            }
+            break;
+        case 'v':
+            value_type = parse_type(optarg);
+            break;
+        default:
+            return 1;
+        }
+    }
+
+    if (argc - optind != 2)
+    {
+        std::cerr << "Usage: trace_convert [-k type] [-v type] <input> <output>" << std::endl;
+        return 1;
+    }
+    const char *input = argv[optind];
+    const char *output_name = argv[optind + 1];
+
+    binary_trace_header header;
+    bool to_text = read_binary_trace_header(input, header);
+    if (to_text)
+    {
+        key_type = header.key_type;
+        value_type = header.value_type;
+    }
+
+    FILE *output = strcmp(output_name, "-") == 0 ? stdout : fopen(output_name, "wb");
+    if (output == NULL)
+    {
+        perror(output_name);
+        return 1;
+    }
+
+    bool converted = false;
+    with_type(key_type, [&](auto key) {
+        with_type(value_type, [&](auto value) {
+            using K = decltype(key);
+            using V = decltype(value);
+            converted = to_text ? binary_to_text<K, V>(input, output) : text_to_binary<K, V>(input, output);
+        });
+    });
+
+    if (output != stdout && fclose(output) != 0)
+    {
+        converted = false;
+    }
+    return converted ? 0 : 1;
+}
@@ -0,0 +1,476 @@
+/**
+ * Generates YCSB style traces in the format test replays: one "Insert: k,v", "Get: k" or
+ * "Remove: k" per line. The same options and seed always give the same trace.
+ *
+ * Usage: trace_gen [options] [output file]
+ *
+ *  -n ops        Operations in the run phase (default 1000000)
+ *  -k keys       Size of the key space (default 100000)
+ *  -l keys       Keys inserted in order before the run phase (default all of them)
+ *  -m g,i,r      Relative weights of Get, Insert and Remove (default 50,45,5)
+ *  -d dist       uniform, zipfian, sequential or adversarial (default zipfian)
+ *  -t theta      Zipfian skew, below 1 (default 0.99, as in YCSB)
+ *  -r ratio      Fraction of Gets that ask for a key that's in the map (default 0.9)
+ *  -s seed       Seed for every random choice (default 1)
+ *
+ * Keys are picked by index into the key space. Zipfian makes the low indices hot; uniform,
+ * zipfian and adversarial then pass the index through a fixed permutation of 32 bit ints so
+ * hot keys are spread out rather than neighbours, while sequential uses the index as the key
+ * and walks through it in order. Adversarial keys are all multiples of 2039, the largest
+ * hash_map capacity, so a full size map chains every one of them into bucket 0.
+ *
+ * Inserts draw from the whole key space, so some are updates of a present key. Removes and
+ * hitting Gets draw until they land on a present key, and missing Gets use a second key space
+ * of the same size that is never inserted. A hit is impossible while the map is empty, so the
+ * hit ratio can come out lower than asked for on write heavy mixes.
+ */
+#include <charconv>
+#include <cmath>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <getopt.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/** The largest capacity hash_map grows to */
+static const uint64_t max_capacity = 2039;
+
+/** How each operation picks the key index it acts on */
+enum class distribution
+{
+    uniform,
+    zipfian,
+    sequential,
+    adversarial
+};
+
+/** splitmix64, so a seed gives the same trace on every platform and standard library */
+class trace_rng
+{
+
+public:
+    explicit trace_rng(uint64_t seed) : _state(seed)
+    {
+    }
+
+    uint64_t next()
+    {
+        uint64_t x = (_state += 0x9e3779b97f4a7c15ULL);
+        x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+        return x ^ (x >> 31);
+    }
+
+    /** Returns a double in [0, 1) */
+    double unit()
+    {
+        return (next() >> 11) * 0x1.0p-53;
+    }
+
+    /** Returns an integer in [0, bound) */
+    uint64_t below(uint64_t bound)
+    {
+        return static_cast<uint64_t>((static_cast<unsigned __int128>(next()) * bound) >> 64);
+    }
+
+private:
+    uint64_t _state;
+};
+
+/**
+ * Draws indices in [0, n) with probability falling off as 1 / (rank + 1)^theta, using the
+ * rejection free method from Gray et al., "Quickly generating billion-record synthetic
+ * databases", as YCSB does. Setup sums n terms once; each draw is constant time.
+ */
+class zipfian_generator
+{
+
+public:
+    zipfian_generator(uint64_t n, double theta) : _n(n)
+    {
+        _zeta2 = 1 + std::pow(0.5, theta);
+        _zetan = 0;
+        for (uint64_t i = 1; i <= n; i++)
+        {
+            _zetan += 1 / std::pow(double(i), theta);
+        }
+        _alpha = 1 / (1 - theta);
+        _eta = (1 - std::pow(2.0 / n, 1 - theta)) / (1 - _zeta2 / _zetan);
+    }
+
+    uint64_t next(trace_rng &rng)
+    {
+        double u = rng.unit();
+        double uz = u * _zetan;
+        if (uz < 1)
+        {
+            return 0;
+        }
+        if (uz < _zeta2)
+        {
+            return 1;
+        }
+        uint64_t index = static_cast<uint64_t>(_n * std::pow(_eta * u - _eta + 1, _alpha));
+        return index < _n ? index : _n - 1;
+    }
+
+private:
+    uint64_t _n;
+    double _zeta2;
+    double _zetan;
+    double _alpha;
+    double _eta;
+};
+
+/** Everything the command line controls */
+struct trace_options
+{
+    uint64_t ops = 1000000;
+    uint64_t keys = 100000;
+    int64_t load = -1;
+    double weights[3] = {50, 45, 5};
+    distribution dist = distribution::zipfian;
+    double theta = 0.99;
+    double hit_ratio = 0.9;
+    uint64_t seed = 1;
+    const char *output = NULL;
+};
+
+/** Buffers lines and writes them out in large blocks */
+class trace_writer
+{
+
+public:
+    explicit trace_writer(FILE *file) : _file(file), _used(0), _buffer(1 << 16)
+    {
+    }
+
+    void insert(int64_t key, uint64_t value)
+    {
+        _reserve();
+        _text("Insert: ");
+        _number(key);
+        _buffer[_used++] = ',';
+        _number(value);
+        _buffer[_used++] = '\n';
+    }
+
+    void get(int64_t key)
+    {
+        _reserve();
+        _text("Get: ");
+        _number(key);
+        _buffer[_used++] = '\n';
+    }
+
+    void remove(int64_t key)
+    {
+        _reserve();
+        _text("Remove: ");
+        _number(key);
+        _buffer[_used++] = '\n';
+    }
+
+    void flush()
+    {
+        if (_used != 0 && fwrite(_buffer.data(), 1, _used, _file) != _used)
+        {
+            perror("trace_gen: write failed");
+            exit(1);
+        }
+        _used = 0;
+    }
+
+private:
+    /** Room for the longest line: "Insert: " plus two 20 digit numbers, a comma and a newline */
+    static const size_t _max_line = 64;
+
+    void _reserve()
+    {
+        if (_buffer.size() - _used < _max_line)
+        {
+            flush();
+        }
+    }
+
+    void _text(const char *text)
+    {
+        while (*text != '\0')
+        {
+            _buffer[_used++] = *text++;
+        }
+    }
+
+    template <typename T>
+    void _number(T number)
+    {
+        _used = std::to_chars(&_buffer[_used], _buffer.data() + _buffer.size(), number).ptr - _buffer.data();
+    }
+
+    FILE *_file;
+    size_t _used;
+    std::vector<char> _buffer;
+};
+
+/** A bijection on 32 bit ints, so distinct indices always give distinct keys */
+static uint32_t permute(uint32_t x)
+{
+    x ^= x >> 16;
+    x *= 0x7feb352dU;
+    x ^= x >> 15;
+    x *= 0x846ca68bU;
+    x ^= x >> 16;
+    return x;
+}
+
+/**
+ * Returns the key for an index. Indices below the key space size are the keys that get
+ * inserted, and those from the key space size up are the ones Gets use to miss.
+ */
+static int64_t key_of(uint64_t index, distribution dist)
+{
+    switch (dist)
+    {
+    case distribution::sequential:
+        return static_cast<int32_t>(index);
+    case distribution::adversarial:
+        return static_cast<int32_t>(index * max_capacity);
+    default:
+        return static_cast<int32_t>(permute(static_cast<uint32_t>(index)));
+    }
+}
+
+/** Picks key indices according to the chosen distribution */
+class key_chooser
+{
+
+public:
+    explicit key_chooser(const trace_options &options)
+        : _dist(options.dist), _keys(options.keys), _cursor(0),
+          _zipfian(options.dist == distribution::zipfian ? options.keys : 2, options.theta)
+    {
+    }
+
+    uint64_t next(trace_rng &rng)
+    {
+        switch (_dist)
+        {
+        case distribution::zipfian:
+            return _zipfian.next(rng);
+        case distribution::sequential:
+        {
+            uint64_t index = _cursor;
+            _cursor = _cursor + 1 == _keys ? 0 : _cursor + 1;
+            return index;
+        }
+        default:
+            return rng.below(_keys);
+        }
+    }
+
+private:
+    distribution _dist;
+    uint64_t _keys;
+    uint64_t _cursor;
+    zipfian_generator _zipfian;
+};
+
+/** Parses "g,i,r" into the three operation weights */
+static bool parse_mix(const char *text, double weights[3])
+{
+    char *end;
+    for (int i = 0; i < 3; i++)
+    {
+        weights[i] = strtod(text, &end);
+        if (end == text || weights[i] < 0 || *end != (i < 2 ? ',' : '\0'))
+        {
+            return false;
+        }
+        text = end + 1;
+    }
+    return weights[0] + weights[1] + weights[2] > 0;
+}
+
+static void usage_error(const char *message)
+{
+    std::cerr << "trace_gen: " << message << std::endl;
+    exit(1);
+}
+
+static trace_options parse_options(int argc, char **argv)
+{
+    trace_options options;
+    int option;
+
+    while ((option = getopt(argc, argv, "n:k:l:m:d:t:r:s:")) != -1)
+    {
+        switch (option)
+        {
+        case 'n':
+            options.ops = std::stoull(optarg);
+            break;
+        case 'k':
+            options.keys = std::stoull(optarg);
+            break;
+        case 'l':
+            options.load = std::stoll(optarg);
+            break;
+        case 'm':
+            if (!parse_mix(optarg, options.weights))
+            {
+                usage_error("-m takes three non-negative weights, like 95,5,0");
+            }
+            break;
+        case 'd':
+        {
+            std::string name = optarg;
+            if (name == "uniform")
+            {
+                options.dist = distribution::uniform;
+            }
+            else if (name == "zipfian")
+            {
+                options.dist = distribution::zipfian;
+            }
+            else if (name == "sequential")
+            {
+                options.dist = distribution::sequential;
+            }
+            else if (name == "adversarial")
+            {
+                options.dist = distribution::adversarial;
+            }
+            else
+            {
+                usage_error("-d must be uniform, zipfian, sequential or adversarial");
+            }
+            break;
+        }
+        case 't':
+            options.theta = std::stod(optarg);
+            break;
+        case 'r':
+            options.hit_ratio = std::stod(optarg);
+            break;
+        case 's':
+            options.seed = std::stoull(optarg);
+            break;
+        default:
+            exit(1);
+        }
+    }
+
+    if (optind < argc)
+    {
+        options.output = argv[optind];
+    }
+
+    // the miss keys double the key space, and test reads keys as ints
+    uint64_t key_limit = options.dist == distribution::adversarial ? (uint64_t(1) << 31) / max_capacity
+                                                                   : uint64_t(1) << 31;
+    if (options.keys == 0 || options.keys * 2 > key_limit)
+    {
+        usage_error("-k must be at least 1 and leave room for as many miss keys as int holds");
+    }
+    if (options.theta <= 0 || options.theta >= 1)
+    {
+        usage_error("-t must be between 0 and 1");
+    }
+    if (options.hit_ratio < 0 || options.hit_ratio > 1)
+    {
+        usage_error("-r must be between 0 and 1");
+    }
+    if (options.load < 0 || uint64_t(options.load) > options.keys)
+    {
+        options.load = options.keys;
+    }
+    return options;
+}
+
+int main(int argc, char **argv)
+{
+    trace_options options = parse_options(argc, argv);
+
+    FILE *file = options.output == NULL ? stdout : fopen(options.output, "w");
+    if (file == NULL)
+    {
+        perror(options.output);
+        return 1;
+    }
+
+    trace_rng rng(options.seed);
+    key_chooser chooser(options);
+    trace_writer writer(file);
+
+    // which indices are in the map, so Removes and hitting Gets can find one
+    std::vector<bool> present(options.keys, false);
+    uint64_t present_count = 0;
+
+    for (uint64_t index = 0; index < uint64_t(options.load); index++)
+    {
+        writer.insert(key_of(index, options.dist), rng.below(1000000));
+        present[index] = true;
+    }
+    present_count = options.load;
+
+    double total = options.weights[0] + options.weights[1] + options.weights[2];
+    double get_below = options.weights[0] / total;
+    double insert_below = (options.weights[0] + options.weights[1]) / total;
+
+    for (uint64_t op = 0; op < options.ops; op++)
+    {
+        double kind = rng.unit();
+        uint64_t index = chooser.next(rng);
+
+        if (kind < insert_below && kind >= get_below)
+        {
+            writer.insert(key_of(index, options.dist), rng.below(1000000));
+            present_count += !present[index];
+            present[index] = true;
+            continue;
+        }
+
+        bool want_present = kind >= insert_below || rng.unit() < options.hit_ratio;
+        if (want_present && present_count == 0)
+        {
+            want_present = false;
+        }
+        else if (want_present)
+        {
+            // redraw to keep the distribution's shape, then walk forward if the map is sparse
+            for (int tries = 0; tries < 64 && !present[index]; tries++)
+            {
+                index = chooser.next(rng);
+            }
+            while (!present[index])
+            {
+                index = index + 1 == options.keys ? 0 : index + 1;
+            }
+        }
+
+        int64_t key = key_of(want_present ? index : options.keys + index, options.dist);
+        if (kind < get_below)
+        {
+            writer.get(key);
+        }
+        else
+        {
+            writer.remove(key);
+            if (want_present)
+            {
+                present[index] = false;
+                present_count--;
+            }
+        }
+    }
+
+    writer.flush();
+    if (file != stdout && fclose(file) != 0)
+    {
+        perror(options.output);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,146 @@
+#ifndef TRACE_READER_H
+#define TRACE_READER_H
+
+#include <stddef.h>
+
+/** The operations a trace file can contain */
+enum trace_op
+{
+    trace_insert,
+    trace_remove,
+    trace_get,
+    trace_op_count
+};
+
+/** One operation read from a trace file */
+template <typename K, typename V>
+struct trace_entry
+{
+    /** Which operation to run */
+    trace_op op;
+
+    /** The key the operation is on */
+    K key;
+
+    /** The value to insert, unused by the other operations */
+    V value;
+
+    /** The line of the trace file the operation came from */
+    size_t line_number;
+};
+
+/** A read only memory mapping of a whole file, which the trace readers parse in place */
+class mapped_file
+{
+
+public:
+    /**
+     * @brief Maps the file at path. Check is_open() before reading
+     */
+    explicit mapped_file(const char *path);
+
+    mapped_file(const mapped_file &other) = delete;
+    mapped_file &operator=(const mapped_file &other) = delete;
+
+    /** Unmap the file */
+    ~mapped_file();
+
+    /**
+     * @brief Return true if the file was opened and mapped
+     */
+    bool is_open() const;
+
+    /**
+     * @brief Return the first byte of the file, or NULL if it's empty or couldn't be mapped
+     */
+    const char *get_data() const;
+
+    /**
+     * @brief Return the length of the file
+     */
+    size_t get_size() const;
+
+private:
+    const char *_data;
+    size_t _size;
+    bool _open;
+};
+
+/**
+ * Reads the "Insert: k,v", "Remove: k" and "Get: k" lines of a trace file without allocating.
+ * The file is memory mapped and each line is tokenized where it lies: a vectorized scan finds
+ * the newline, the command is compared in place and the numbers are parsed with
+ * std::from_chars. Lines with any other command, like the point values at the top of a
+ * grading trace, are skipped.
+ *
+ * K and V must be arithmetic types that std::from_chars can parse.
+ */
+template <typename K, typename V>
+class trace_reader
+{
+
+public:
+    /**
+     * @brief Maps the trace file at path. Check is_open() before reading
+     */
+    explicit trace_reader(const char *path);
+
+    trace_reader(const trace_reader &other) = delete;
+    trace_reader &operator=(const trace_reader &other) = delete;
+
+    /**
+     * @brief Return true if the file was opened and mapped
+     */
+    bool is_open() const;
+
+    /**
+     * @brief Read the next operation into entry
+     *
+     * @return
+     *  False at the end of the file or on a line that can't be parsed, which failed() tells
+     *  apart
+     */
+    bool next(trace_entry<K, V> &entry);
+
+    /**
+     * @brief Return true if next() stopped on a line it couldn't parse
+     */
+    bool failed() const;
+
+    /**
+     * @brief Return the number of the line next() last read, counting from 1
+     */
+    size_t get_line_number() const;
+
+    /**
+     * @brief Go back to the start of the file
+     */
+    void rewind();
+
+private:
+    /** Returns the first newline in [from, end), or end if there isn't one */
+    static const char *_find_newline(const char *from, const char *end);
+
+    /** Returns the first character in [from, end) that isn't a space or tab */
+    static const char *_skip_blanks(const char *from, const char *end);
+
+    /** Parses a number after any blanks, returning where it ended or NULL if there wasn't one */
+    template <typename T>
+    static const char *_parse(const char *from, const char *end, T &number);
+
+    /** The trace file */
+    mapped_file _file;
+
+    /** Where the next line starts */
+    const char *_cursor;
+
+    /** The number of the line last read */
+    size_t _line_number;
+
+    bool _failed;
+};
+
+/** See hash_list.h for an explanation of why this odd line of code is here */
+#include "trace_reader.hpp"
+
+#endif
@@ -0,0 +1,197 @@
+#include "trace_reader.h"
+
+#include <charconv>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+inline mapped_file::mapped_file(const char *path) : _data(NULL), _size(0), _open(false)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        return;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) == 0)
+    {
+        _size = info.st_size;
+        if (_size == 0)
+        {
+            _open = true;
+        }
+        else
+        {
+            void *data = mmap(NULL, _size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+            if (data != MAP_FAILED)
+            {
+                madvise(data, _size, MADV_SEQUENTIAL);
+                _data = static_cast<const char *>(data);
+                _open = true;
+            }
+        }
+    }
+    close(fd);
+}
+
+inline mapped_file::~mapped_file()
+{
+    if (_data != NULL)
+    {
+        munmap(const_cast<char *>(_data), _size);
+    }
+}
+
+inline bool mapped_file::is_open() const
+{
+    return _open;
+}
+
+inline const char *mapped_file::get_data() const
+{
+    return _data;
+}
+
+inline size_t mapped_file::get_size() const
+{
+    return _size;
+}
+
+template <typename K, typename V>
+trace_reader<K, V>::trace_reader(const char *path)
+    : _file(path), _cursor(_file.get_data()), _line_number(0), _failed(false)
+{
+}
+
+template <typename K, typename V>
+bool trace_reader<K, V>::is_open() const
+{
+    return _file.is_open();
+}
+
+template <typename K, typename V>
+bool trace_reader<K, V>::next(trace_entry<K, V> &entry)
+{
+    const char *end = _file.get_data() + _file.get_size();
+
+    while (!_failed && _cursor < end)
+    {
+        const char *line = _cursor;
+        const char *line_end = _find_newline(line, end);
+        _cursor = line_end + (line_end < end);
+        _line_number++;
+
+        // the commands are matched with their colon, so other lines only need searching for one
+        size_t length = line_end - line;
+        const char *args;
+        if (length > 7 && memcmp(line, "Insert:", 7) == 0)
+        {
+            entry.op = trace_insert;
+            args = _parse(line + 7, line_end, entry.key);
+            if (args == NULL || args == line_end || *args != ',')
+            {
+                _failed = true;
+                break;
+            }
+            args = _parse(args + 1, line_end, entry.value);
+        }
+        else if (length > 4 && memcmp(line, "Get:", 4) == 0)
+        {
+            entry.op = trace_get;
+            args = _parse(line + 4, line_end, entry.key);
+        }
+        else if (length > 7 && memcmp(line, "Remove:", 7) == 0)
+        {
+            entry.op = trace_remove;
+            args = _parse(line + 7, line_end, entry.key);
+        }
+        else if (memchr(line, ':', length) == NULL)
+        {
+            _failed = true;
+            break;
+        }
+        else
+        {
+            continue;
+        }
+
+        if (args == NULL)
+        {
+            _failed = true;
+            break;
+        }
+        entry.line_number = _line_number;
+        return true;
+    }
+
+    return false;
+}
+
+template <typename K, typename V>
+bool trace_reader<K, V>::failed() const
+{
+    return _failed;
+}
+
+template <typename K, typename V>
+size_t trace_reader<K, V>::get_line_number() const
+{
+    return _line_number;
+}
+
+template <typename K, typename V>
+void trace_reader<K, V>::rewind()
+{
+    _cursor = _file.get_data();
+    _line_number = 0;
+    _failed = false;
+}
+
+template <typename K, typename V>
+const char *trace_reader<K, V>::_find_newline(const char *from, const char *end)
+{
+#ifdef __SSE2__
+    // sixteen bytes per compare; lines are short, so this mostly saves the call memchr costs
+    const __m128i newline = _mm_set1_epi8('\n');
+    while (end - from >= 16)
+    {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(from));
+        int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(block, newline));
+        if (mask != 0)
+        {
+            return from + __builtin_ctz(mask);
+        }
+        from += 16;
+    }
+#endif
+    while (from < end && *from != '\n')
+    {
+        from++;
+    }
+    return from;
+}
+
+template <typename K, typename V>
+const char *trace_reader<K, V>::_skip_blanks(const char *from, const char *end)
+{
+    while (from < end && (*from == ' ' || *from == '\t'))
+    {
+        from++;
+    }
+    return from;
+}
+
+template <typename K, typename V>
+template <typename T>
+const char *trace_reader<K, V>::_parse(const char *from, const char *end, T &number)
+{
+    std::from_chars_result result = std::from_chars(_skip_blanks(from, end), end, number);
+    return result.ec == std::errc() ? result.ptr : NULL;
+}